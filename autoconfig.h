@@ -4,6 +4,9 @@
 /* Define to enable debugging features */
 #define ENABLE_DEBUG 0
 
+/* Define to enable trace points in the solver */
+#define ENABLE_TRACE 0
+
 /* Define if ncurses is available */
 #define HAVE_NCURSES 1
 
@@ -0,0 +1,135 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Time and node budgets.
+ *
+ * The solver polls the budget cooperatively: between line solves and at
+ * every search node. Once the budget has run out (or the user has pressed
+ * Ctrl-C), all the workers unwind as quickly as they can, and whatever has
+ * been deduced so far is left in the main picture.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "budget.h"
+#include "timer.h"
+
+#define NODE_GRAIN 64 // nodes a worker counts locally before reporting them
+
+atomic_int budget_state = BUDGET_LEFT;
+
+static double time_limit = 0.0, deadline = 0.0;
+static uint64_t node_limit = 0, node_grain = 1;
+static atomic_uint_fast64_t nodes_spent;
+static __thread uint64_t local_nodes = 0;
+static atomic_bool armed;
+
+void setup_budget(double seconds, uint64_t nodes)
+// Zero means no limit.
+// This also resets the budget, so that another puzzle can be solved.
+{
+  atomic_store(&budget_state, BUDGET_LEFT);
+  deadline = 0.0;
+  time_limit = seconds;
+  node_limit = nodes;
+  // Reporting in bulk is cheaper, but makes the limit less precise.
+  node_grain = node_limit / 1024;
+  if (node_grain < 1)
+    node_grain = 1;
+  if (node_grain > NODE_GRAIN)
+    node_grain = NODE_GRAIN;
+  atomic_store(&nodes_spent, 0);
+  atomic_store(&armed, false);
+}
+
+void start_budget(void)
+// Start the clock. From now on, Ctrl-C interrupts the solver.
+{
+  if (time_limit > 0.0)
+    deadline = get_time() + time_limit;
+  atomic_store(&armed, true);
+}
+
+void stop_budget(void)
+// The solver is done; Ctrl-C exits again.
+{
+  atomic_store(&armed, false);
+}
+
+static void exhaust_budget(BudgetState state)
+// The first reason to stop is the one that is reported.
+{
+  int left = BUDGET_LEFT;
+  atomic_compare_exchange_strong(&budget_state, &left, state);
+}
+
+bool interrupt_budget(void)
+// Called from the SIGINT handler.
+// Return false if the solver is not running or has been interrupted already,
+// in which case the caller should just exit.
+{
+  if (!atomic_load(&armed) || is_out_of_budget())
+    return false;
+  exhaust_budget(BUDGET_INTERRUPT);
+  return true;
+}
+
+bool check_budget(void)
+// Return true if the solver should stop.
+{
+  if (deadline > 0.0 && !is_out_of_budget() && get_time() >= deadline)
+    exhaust_budget(BUDGET_TIME);
+  return is_out_of_budget();
+}
+
+bool charge_node(void)
+// Count a search node against the node limit.
+// Return true if the solver should stop.
+{
+  if (node_limit > 0 && ++local_nodes >= node_grain)
+  {
+    if (atomic_fetch_add_explicit(&nodes_spent, local_nodes, memory_order_relaxed) + local_nodes > node_limit)
+      exhaust_budget(BUDGET_NODES);
+    local_nodes = 0;
+  }
+  return check_budget();
+}
+
+const char *describe_budget(void)
+{
+  switch (atomic_load(&budget_state))
+  {
+  case BUDGET_TIME:
+    return "Time limit exceeded";
+  case BUDGET_NODES:
+    return "Node limit exceeded";
+  case BUDGET_INTERRUPT:
+    return "Interrupted";
+  default:
+    return NULL;
+  }
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,55 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef NONOGRAM_BUDGET_H
+#define NONOGRAM_BUDGET_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+  BUDGET_LEFT,
+  BUDGET_TIME,      // the time limit has been exceeded
+  BUDGET_NODES,     // the node limit has been exceeded
+  BUDGET_INTERRUPT  // the user pressed Ctrl-C
+} BudgetState;
+
+extern atomic_int budget_state;
+
+void setup_budget(double, uint64_t);
+void start_budget(void);
+void stop_budget(void);
+bool interrupt_budget(void);
+bool check_budget(void);
+bool charge_node(void);
+const char *describe_budget(void);
+
+static inline bool is_out_of_budget(void)
+{
+  return atomic_load_explicit(&budget_state, memory_order_relaxed) != BUDGET_LEFT;
+}
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
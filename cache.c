@@ -0,0 +1,210 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* A directory of solved puzzles, so that the same puzzle is not solved twice.
+ *
+ * The key of a puzzle is its size followed by the clues of every row and
+ * column, each list preceded by its length. An entry is named after a hash
+ * of the key and holds:
+ *
+ *   the magic string,
+ *   the key (so that hash collisions are mere misses),
+ *   the cells, 8 per byte, with set bits for X.
+ *
+ * All the numbers are in the native byte order. Entries are written to
+ * temporary files and renamed into place, so concurrent solvers never see
+ * half of an entry.
+ */
+
+#include "autoconfig.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "memory.h"
+
+#define CACHE_MAGIC "nonogram-cache-1"
+
+typedef struct
+{
+  uint32_t *words;
+  size_t size; // in words
+  uint64_t hash;
+  char *path;
+} CacheKey;
+
+static size_t add_clues(uint32_t *words, const unsigned int *border, unsigned int size)
+// Append the length of a list of clues, then the clues.
+{
+  size_t n = 0;
+
+  while (n < size && border[n] != 0)
+  {
+    words[n + 1] = border[n];
+    n++;
+  }
+  words[0] = n;
+  return n + 1;
+}
+
+static void make_key(const char *dir, CacheKey *key)
+{
+  unsigned int i, j;
+  size_t n;
+
+  // Room for the size, and for every list with its length.
+  n = 2 + xpysize;
+  for (i = 0; i < ysize; i++)
+    for (j = 0; j < xsize && leftborder[left_offset(i) + j] != 0; j++)
+      n++;
+  for (i = 0; i < xsize; i++)
+    for (j = 0; j < ysize && topborder[top_offset(i) + j] != 0; j++)
+      n++;
+  key->words = alloc(n * sizeof(uint32_t));
+  key->words[0] = xsize;
+  key->words[1] = ysize;
+  n = 2;
+  for (i = 0; i < ysize; i++)
+    n += add_clues(key->words + n, leftborder + left_offset(i), xsize);
+  for (i = 0; i < xsize; i++)
+    n += add_clues(key->words + n, topborder + top_offset(i), ysize);
+  key->size = n;
+
+  // 64-bit FNV-1a
+  key->hash = 0xcbf29ce484222325ULL;
+  for (i = 0; i < n * sizeof(uint32_t); i++)
+  {
+    key->hash ^= ((unsigned char*) key->words)[i];
+    key->hash *= 0x100000001b3ULL;
+  }
+
+  key->path = alloc(strlen(dir) + 18);
+  sprintf(key->path, "%s/%016jx", dir, (uintmax_t) key->hash);
+}
+
+static void free_key(CacheKey *key)
+{
+  free(key->words);
+  free(key->path);
+}
+
+static inline size_t packed_size(void)
+{
+  return (vsize + 7) / 8;
+}
+
+bool lookup_cache(const char *dir, bit *bits)
+// Fill in the bits from the cache. Return false if the puzzle isn't there.
+{
+  CacheKey key;
+  FILE *file;
+  char magic[sizeof(CACHE_MAGIC)];
+  uint32_t size, *words = NULL;
+  unsigned char *packed = NULL;
+  unsigned int i;
+  bool found = false;
+
+  make_key(dir, &key);
+  file = fopen(key.path, "rb");
+  if (file == NULL)
+    goto done;
+  if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0)
+    goto done;
+  if (fread(&size, sizeof(size), 1, file) != 1 || size != key.size)
+    goto done;
+  words = alloc(size * sizeof(uint32_t));
+  packed = alloc(packed_size());
+  if (fread(words, sizeof(uint32_t), size, file) != size || memcmp(words, key.words, size * sizeof(uint32_t)) != 0)
+    goto done;
+  if (fread(packed, packed_size(), 1, file) != 1)
+    goto done;
+  for (i = 0; i < vsize; i++)
+    bits[i] = (packed[i / 8] >> (i % 8)) & 1 ? X : O;
+  found = true;
+done:
+  if (file != NULL)
+    fclose(file);
+  free(words);
+  free(packed);
+  free_key(&key);
+  return found;
+}
+
+void store_cache(const char *dir, const bit *bits)
+// Add a solved puzzle to the cache. Failures are reported, but not fatal.
+{
+  CacheKey key;
+  FILE *file = NULL;
+  char *tmppath;
+  unsigned char *packed;
+  uint32_t size;
+  unsigned int i;
+  int fd;
+  bool res;
+
+  if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+  {
+    perror(dir);
+    return;
+  }
+  make_key(dir, &key);
+  tmppath = alloc(strlen(dir) + 9);
+  sprintf(tmppath, "%s/.XXXXXX", dir);
+  packed = alloc(packed_size());
+  memset(packed, 0, packed_size());
+  for (i = 0; i < vsize; i++)
+    if (bits[i] == X)
+      packed[i / 8] |= 1 << (i % 8);
+  size = key.size;
+
+  fd = mkstemp(tmppath);
+  // mkstemp() makes the file private, but the cache may well be shared.
+  res = fd >= 0 && fchmod(fd, 0644) == 0 && (file = fdopen(fd, "wb")) != NULL;
+  res = res &&
+    fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC), 1, file) == 1 &&
+    fwrite(&size, sizeof(size), 1, file) == 1 &&
+    fwrite(key.words, sizeof(uint32_t), size, file) == size &&
+    fwrite(packed, packed_size(), 1, file) == 1;
+  if (file != NULL && fclose(file) != 0)
+    res = false;
+  else if (file == NULL && fd >= 0)
+    close(fd);
+  if (res && rename(tmppath, key.path) != 0)
+    res = false;
+  if (!res)
+  {
+    perror(key.path);
+    if (fd >= 0)
+      unlink(tmppath);
+  }
+  free(packed);
+  free(tmppath);
+  free_key(&key);
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
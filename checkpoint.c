@@ -0,0 +1,372 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* Writing and reading checkpoints (see checkpoint.h), deciding when to
+ * take them: every so often, and whenever SIGUSR1 arrives, and following
+ * them back to where the search had got.
+ */
+
+#include "autoconfig.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "budget.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "memory.h"
+#include "timer.h"
+
+static double interval = 0.0, next_time = 0.0;
+static atomic_bool requested;
+
+static void handle_sigusr1()
+{
+  atomic_store(&requested, true);
+}
+
+void setup_checkpoints(double seconds)
+// Take a checkpoint every so many seconds (or only on SIGUSR1, if zero).
+{
+  interval = seconds;
+  next_time = interval > 0.0 ? get_time() + interval : 0.0;
+  atomic_init(&requested, false);
+#ifdef HAVE_SIGACTION
+  struct sigaction act;
+  act.sa_handler = handle_sigusr1;
+  act.sa_flags = SA_RESTART;
+  sigemptyset(&act.sa_mask);
+  sigaction(SIGUSR1, &act, NULL);
+#endif
+}
+
+bool is_checkpoint_due(void)
+{
+  return atomic_load_explicit(&requested, memory_order_relaxed) || (next_time > 0.0 && get_time() >= next_time);
+}
+
+static inline uint64_t hash_word(uint64_t hash, uint32_t word)
+// Add a word to a 64-bit FNV-1a hash.
+{
+  unsigned int i;
+  for (i = 0; i < sizeof(word); i++)
+  {
+    hash ^= ((unsigned char*) &word)[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static uint64_t hash_puzzle(void)
+// Hash the size and the clues, each list preceded by its length.
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  unsigned int i, j, size, *border;
+
+  hash = hash_word(hash, xsize);
+  hash = hash_word(hash, ysize);
+  for (i = 0; i < xpysize; i++)
+  {
+    if (i < ysize)
+      border = leftborder + left_offset(i), size = xsize;
+    else
+      border = topborder + top_offset(i - ysize), size = ysize;
+    for (j = 0; j < size && border[j] != 0; j++)
+      ;
+    hash = hash_word(hash, j);
+    for (j = 0; j < size && border[j] != 0; j++)
+      hash = hash_word(hash, border[j]);
+  }
+  return hash;
+}
+
+static inline size_t packed_size(void)
+{
+  return (vsize + 3) / 4;
+}
+
+bool write_checkpoint(const char *path, Checkpoint *checkpoint)
+// Fill in the rest of the header, and replace the file at the path.
+// Failures are reported, but not fatal: the next checkpoint may do better.
+{
+  CheckpointHeader *header = &checkpoint->header;
+  FILE *file = NULL;
+  char *tmppath;
+  unsigned char *packed;
+  unsigned int i, code;
+  int fd;
+  bool res;
+
+  atomic_store(&requested, false);
+  if (interval > 0.0)
+    next_time = get_time() + interval;
+
+  memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+  header->hash = hash_puzzle();
+  header->xsize = xsize;
+  header->ysize = ysize;
+  packed = alloc(packed_size());
+  memset(packed, 0, packed_size());
+  for (i = 0; i < vsize; i++)
+  {
+    code = checkpoint->cells[i] == X ? 1 : checkpoint->cells[i] == O ? 2 : 0;
+    packed[i / 4] |= code << (i % 4 * 2);
+  }
+  tmppath = alloc(strlen(path) + 8);
+  sprintf(tmppath, "%s.XXXXXX", path);
+
+  fd = mkstemp(tmppath);
+  res = fd >= 0 && (file = fdopen(fd, "wb")) != NULL;
+  res = res &&
+    fwrite(header, sizeof(*header), 1, file) == 1 &&
+    fwrite(packed, packed_size(), 1, file) == 1 &&
+    fwrite(checkpoint->steps, sizeof(uint32_t), header->nsteps, file) == header->nsteps;
+  if (file != NULL && fclose(file) != 0)
+    res = false;
+  else if (file == NULL && fd >= 0)
+    close(fd);
+  if (res && rename(tmppath, path) != 0)
+    res = false;
+  if (!res)
+  {
+    perror(path);
+    if (fd >= 0)
+      unlink(tmppath);
+  }
+  free(packed);
+  free(tmppath);
+  return res;
+}
+
+bool read_checkpoint(const char *path, Checkpoint *checkpoint)
+// Read a checkpoint of the puzzle that has been read.
+// Return false if there's none, or it's of another puzzle.
+{
+  CheckpointHeader *header = &checkpoint->header;
+  FILE *file;
+  unsigned char *packed = NULL;
+  unsigned int i, code;
+  bool res = false;
+
+  checkpoint->cells = NULL;
+  checkpoint->steps = NULL;
+  file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+  if (fread(header, sizeof(*header), 1, file) != 1 || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0)
+    goto done;
+  if (header->hash != hash_puzzle() || header->xsize != xsize || header->ysize != ysize || header->nsteps > vsize)
+    goto done;
+  packed = alloc(packed_size());
+  checkpoint->cells = alloc(vsize * sizeof(bit));
+  checkpoint->steps = alloc((header->nsteps + 1) * sizeof(uint32_t));
+  if (fread(packed, packed_size(), 1, file) != 1)
+    goto done;
+  if (fread(checkpoint->steps, sizeof(uint32_t), header->nsteps, file) != header->nsteps)
+    goto done;
+  for (i = 0; i < vsize; i++)
+  {
+    code = packed[i / 4] >> (i % 4 * 2) & 3;
+    if (code == 3)
+      goto done;
+    checkpoint->cells[i] = code == 1 ? X : code == 2 ? O : Q;
+  }
+  for (i = 0; i < header->nsteps; i++)
+    if (checkpoint->steps[i] / 2 >= vsize || checkpoint->cells[checkpoint->steps[i] / 2] != Q)
+      goto done;
+  res = fgetc(file) == EOF;
+done:
+  fclose(file);
+  free(packed);
+  if (!res)
+    free_checkpoint(checkpoint);
+  return res;
+}
+
+void free_checkpoint(Checkpoint *checkpoint)
+{
+  free(checkpoint->cells);
+  free(checkpoint->steps);
+  checkpoint->cells = NULL;
+  checkpoint->steps = NULL;
+}
+
+static Checkpoint resumed; // the checkpoint being resumed from
+static unsigned int resumed_steps; // how many of its steps have been retraced
+static const Region *searched_regions; // of the search being checkpointed
+static double solve_starttime;
+static bool checkpoint_on_stop; // whether the search has saved where it stopped
+
+bool resume_checkpoint(const char *path)
+// Read the checkpoint that the search is to resume from.
+{
+  return read_checkpoint(path, &resumed);
+}
+
+void stop_resuming(void)
+{
+  free_checkpoint(&resumed);
+  resumed_steps = 0;
+}
+
+double start_checkpoints(double starttime)
+// Start counting the time of the solver at starttime, carrying on the time
+// and the statistics of the run being resumed. Return the adjusted start.
+{
+  int s;
+  if (resumed.cells != NULL)
+  {
+    for (s = 0; s < STAT_COUNT; s++)
+      add_stat(s, resumed.header.stats[s]);
+    starttime -= resumed.header.elapsed;
+  }
+  solve_starttime = starttime;
+  checkpoint_on_stop = false;
+  return starttime;
+}
+
+typedef struct
+{
+  uint64_t stamp;
+  uint32_t step;
+} CheckpointStep;
+
+static int compare_steps(const void *a, const void *b)
+{
+  uint64_t x = ((const CheckpointStep*) a)->stamp, y = ((const CheckpointStep*) b)->stamp;
+  return (x > y) - (x < y);
+}
+
+bool is_resuming(void)
+{
+  return resumed.steps != NULL && resumed_steps < resumed.header.nsteps;
+}
+
+void save_checkpoint(Picture *mpicture, const Region *region)
+// Write down the way from the root of the search to this node,
+// so that another run can resume from it.
+// If the region is NULL, the search hasn't started yet: just keep the cells.
+{
+  Trail *trail = mpicture->trail;
+  CheckpointStep *steps;
+  Checkpoint checkpoint;
+  unsigned int i, n, nsteps = 0;
+  int s;
+
+  if (is_resuming())
+  {
+    // The search hasn't got back to where it was yet.
+    resumed.header.elapsed = get_time() - solve_starttime;
+    for (s = 0; s < STAT_COUNT; s++)
+      resumed.header.stats[s] = get_stat(s);
+    write_checkpoint(config.checkpoint_file, &resumed);
+    return;
+  }
+  checkpoint.cells = alloc(vsize * sizeof(bit));
+  memcpy(checkpoint.cells, mpicture->bits, vsize * sizeof(bit));
+  steps = alloc(((region != NULL ? region->ncells : 0) + 1) * sizeof(CheckpointStep));
+  for (i = 0; region != NULL && i < region->ncells; i++)
+  {
+    n = region->cells[i];
+    checkpoint.cells[n] = Q;
+    if (mpicture->bits[n] == Q)
+      continue;
+    if (trail->cells[i].reason != REASON_DECISION && trail->cells[i].reason != REASON_NOGOOD)
+      continue;
+    steps[nsteps].stamp = trail->cells[i].stamp;
+    steps[nsteps++].step = 2 * n + (trail->cells[i].reason == REASON_NOGOOD);
+  }
+  qsort(steps, nsteps, sizeof(CheckpointStep), compare_steps);
+  checkpoint.steps = alloc((nsteps + 1) * sizeof(uint32_t));
+  for (i = 0; i < nsteps; i++)
+    checkpoint.steps[i] = steps[i].step;
+  free(steps);
+  checkpoint.header.region = region != NULL ? region - searched_regions : 0;
+  checkpoint.header.nsteps = nsteps;
+  checkpoint.header.elapsed = get_time() - solve_starttime;
+  for (s = 0; s < STAT_COUNT; s++)
+    checkpoint.header.stats[s] = get_stat(s);
+  write_checkpoint(config.checkpoint_file, &checkpoint);
+  free_checkpoint(&checkpoint);
+}
+
+void checkpoint_search(Picture *mpicture, const Region *region)
+// Save a checkpoint if one is due, or if the search is giving up:
+// the deepest node to notice that saves where it has stopped.
+{
+  if (config.checkpoint_file == NULL)
+    return;
+  if (is_out_of_budget())
+  {
+    if (checkpoint_on_stop)
+      return;
+    checkpoint_on_stop = true;
+  }
+  else if (!is_checkpoint_due())
+    return;
+  save_checkpoint(mpicture, region);
+}
+
+static void report_checkpoint_mismatch(void)
+{
+  fprintf(stderr, "The checkpoint doesn't match the search!\n");
+  exit(EXIT_FAILURE);
+}
+
+bool retrace_step(const Region *region, unsigned int n)
+// While resuming, take the next step of the checkpoint, which must be about
+// the n-th cell. Return true if its first value has been refuted.
+{
+  uint32_t step = resumed.steps[resumed_steps++];
+  if (step / 2 != n || (unsigned int)(region - searched_regions) != resumed.header.region)
+    report_checkpoint_mismatch();
+  return step & 1;
+}
+
+void resume_search(Picture *mpicture, const Region *regions)
+// Note the regions of the search being started. If it's being resumed,
+// put back the cells of the regions that had been solved before the checkpoint.
+{
+  unsigned int n;
+  searched_regions = regions;
+  if (resumed.cells == NULL)
+    return;
+  for (n = 0; n < vsize; n++)
+  {
+    if (resumed.cells[n] == Q)
+      continue;
+    if (mpicture->bits[n] == Q)
+      put_cell(mpicture, n, resumed.cells[n]);
+    else if (mpicture->bits[n] != resumed.cells[n])
+      report_checkpoint_mismatch();
+  }
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,95 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+
+/* Checkpoints: snapshots of a backtracking search, from which another run
+ * of the solver can resume it.
+ *
+ * A search node is reached from the grid left by line solving by a path of
+ * steps: decisions, for which the first value is being tried, and refuted
+ * decisions, for which it has already failed, so the cell got the other
+ * value. The steps of the node that was being searched are enough to get
+ * back to it; the branches that had been left for later are the other values
+ * of the decisions on the path.
+ *
+ * A checkpoint consists of:
+ *
+ *   the header,
+ *   the cells, 4 per byte (0 for unknown, 1 for filled, 2 for empty),
+ *   the steps, as 32-bit words: the cell, times 2, plus 1 if it's refuted.
+ *
+ * The cells that are known are those found before the search and in the
+ * regions that had been solved already; the cells of the current region are
+ * unknown. All the numbers are in the native byte order. A checkpoint is
+ * written to a temporary file and then renamed into place, so that a crash
+ * never leaves half of it behind.
+ */
+
+#ifndef NONOGRAM_CHECKPOINT_H
+#define NONOGRAM_CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nonogram.h"
+#include "stats.h"
+
+#define CHECKPOINT_MAGIC "nonogram-ckpt-1" // with the NUL, 16 bytes
+
+typedef struct
+{
+  char magic[16];
+  uint64_t hash; // of the size and the clues
+  uint32_t xsize, ysize;
+  uint32_t region; // index of the region being searched
+  uint32_t nsteps;
+  double elapsed; // seconds spent on the puzzle
+  uint64_t stats[STAT_COUNT];
+} CheckpointHeader;
+
+typedef struct
+{
+  CheckpointHeader header;
+  bit *cells;
+  uint32_t *steps;
+} Checkpoint;
+
+void setup_checkpoints(double);
+bool is_checkpoint_due(void);
+bool write_checkpoint(const char*, Checkpoint*);
+bool read_checkpoint(const char*, Checkpoint*);
+void free_checkpoint(Checkpoint*);
+
+// Checkpointing the search of the solver
+bool resume_checkpoint(const char*);
+void stop_resuming(void);
+double start_checkpoints(double);
+bool is_resuming(void);
+void save_checkpoint(Picture*, const Region*);
+void checkpoint_search(Picture*, const Region*);
+bool retrace_step(const Region*, unsigned int);
+void resume_search(Picture*, const Region*);
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
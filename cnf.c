@@ -0,0 +1,168 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Encoding of partially solved pictures into CNF.
+ *
+ * Every unknown cell gets a variable, which is true if the cell is filled.
+ * Block positions are encoded with “ladder” variables: T(b, p) is true if the
+ * b-th block of the line starts at position p or earlier. Every clause is at
+ * most ternary:
+ *
+ *   T(b, p) → T(b, p + 1)                     (the ladder)
+ *   T(b + 1, p) → T(b, p - len(b) - 1)        (blocks are ordered and apart)
+ *   T(b, c) ∧ ¬T(b, c - len(b)) → cell(c)     (blocks are filled)
+ *   T(b, c - len(b)) ∧ ¬T(b + 1, c) → ¬cell(c) (gaps are empty)
+ *
+ * T(b, p) is a constant outside the range of possible starts of the block,
+ * and so are the known cells; clauses are simplified accordingly.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "cnf.h"
+#include "memory.h"
+#include "nonogram.h"
+#include "sat.h"
+
+#define TRUE INT_MAX
+#define FALSE (-INT_MAX)
+
+typedef struct
+{
+  unsigned int length;
+  int earliest, latest; // possible starts
+  int base; // variable of T(b, earliest)
+} Block;
+
+static void add_simplified_clause(Cnf *cnf, int a, int b, int c)
+// Add the clause (a ∨ b ∨ c); any of the literals may be a constant.
+{
+  int literals[3];
+  unsigned int n = 0;
+  if (a == TRUE || b == TRUE || c == TRUE)
+    return;
+  if (a != FALSE)
+    literals[n++] = a;
+  if (b != FALSE)
+    literals[n++] = b;
+  if (c != FALSE)
+    literals[n++] = c;
+  add_clause(cnf, literals, n);
+}
+
+static inline int ladder(const Block *block, int p)
+// T(b, p)
+{
+  if (p < block->earliest)
+    return FALSE;
+  if (p >= block->latest)
+    return TRUE;
+  return block->base + p - block->earliest;
+}
+
+static void encode_line(Cnf *cnf, const int *cells, int size, const unsigned int *border, Block *blocks)
+{
+  int i, k, p, c, sum;
+
+  for (k = 0; border[k] > 0; k++)
+    blocks[k].length = border[k];
+  if (k == 0)
+  {
+    for (c = 0; c < size; c++)
+      add_simplified_clause(cnf, -cells[c], FALSE, FALSE);
+    return;
+  }
+  for (i = 0, sum = 0; i < k; i++)
+  {
+    blocks[i].earliest = sum;
+    sum += blocks[i].length + 1;
+  }
+  for (i = k - 1, sum = size + 1; i >= 0; i--)
+  {
+    sum -= blocks[i].length + 1;
+    blocks[i].latest = sum;
+  }
+  if (blocks[0].latest < blocks[0].earliest)
+  {
+    add_clause(cnf, NULL, 0); // the clues don't fit at all
+    return;
+  }
+  for (i = 0; i < k; i++)
+  {
+    blocks[i].base = cnf->nvars + 1;
+    for (p = blocks[i].earliest; p < blocks[i].latest; p++)
+      new_variable(cnf);
+  }
+
+  for (i = 0; i < k; i++)
+  for (p = blocks[i].earliest; p < blocks[i].latest; p++)
+  {
+    add_simplified_clause(cnf, -ladder(blocks + i, p), ladder(blocks + i, p + 1), FALSE);
+    if (i + 1 < k)
+      add_simplified_clause(cnf, -ladder(blocks + i + 1, p + blocks[i].length + 1), ladder(blocks + i, p), FALSE);
+  }
+
+  for (c = 0; c < size; c++)
+  {
+    for (i = 0; i < k; i++)
+      add_simplified_clause(cnf, -ladder(blocks + i, c), ladder(blocks + i, c - (int)blocks[i].length), cells[c]);
+    add_simplified_clause(cnf, ladder(blocks, c), -cells[c], FALSE);
+    for (i = 0; i + 1 < k; i++)
+      add_simplified_clause(cnf, -ladder(blocks + i, c - (int)blocks[i].length), ladder(blocks + i + 1, c), -cells[c]);
+    add_simplified_clause(cnf, -ladder(blocks + k - 1, c - (int)blocks[k - 1].length), -cells[c], FALSE);
+  }
+}
+
+void encode_picture(Picture *mpicture, Cnf *cnf, unsigned int *cellvars)
+// Encode the unknown part of the picture.
+// Set cellvars[n] to the variable of the n-th cell (0 for the known cells).
+{
+  unsigned int i, j, n;
+  int *cells = alloc((xsize > ysize ? xsize : ysize) * sizeof(int));
+  Block *blocks = alloc((lmax > tmax ? lmax : tmax) * sizeof(Block));
+
+  for (n = 0; n < vsize; n++)
+    cellvars[n] = mpicture->bits[n] == Q ? new_variable(cnf) : 0;
+  for (i = 0; i < xpysize; i++)
+  {
+    if (mpicture->linecounter[i] == 0)
+      continue;
+    if (i < ysize)
+    {
+      for (j = 0, n = i * xsize; j < xsize; j++, n++)
+        cells[j] = cellvars[n] > 0 ? (int)cellvars[n] : mpicture->bits[n] == X ? TRUE : FALSE;
+      encode_line(cnf, cells, xsize, leftborder + left_offset(i), blocks);
+    }
+    else
+    {
+      for (j = 0, n = i - ysize; j < ysize; j++, n += xsize)
+        cells[j] = cellvars[n] > 0 ? (int)cellvars[n] : mpicture->bits[n] == X ? TRUE : FALSE;
+      encode_line(cnf, cells, ysize, topborder + top_offset(i - ysize), blocks);
+    }
+  }
+  free(blocks);
+  free(cells);
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
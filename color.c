@@ -0,0 +1,440 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/* Colored puzzles.
+ *
+ * A block has a color as well as a length, and blocks of different colors
+ * may touch. Every cell holds the set of colors it may still have, as a bit
+ * mask; the background is one of the colors. The line solver finds, for
+ * every cell, the colors that some placement of the blocks allows, and
+ * intersects them with what the cell already holds.
+ *
+ * A placement is found with a dynamic program over the blocks and the cells:
+ * whether the first j blocks fit into the first i cells, and whether the
+ * last j blocks fit into the last cells from i on. Each table has a second
+ * flavour in which the border cell is background, which is what a block
+ * needs next to it if its neighbour has the same color.
+ *
+ * The search picks a cell with the fewest colors left and tries every one.
+ */
+
+#include "autoconfig.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "budget.h"
+#include "color.h"
+#include "io.h"
+#include "memory.h"
+#include "nonogram.h"
+#include "queue.h"
+#include "stats.h"
+
+#define NO_CELL ((unsigned int)-1)
+
+typedef struct
+{
+  Arena *arena;
+  Queue *queue;
+  domain *line; // the cells of the line being solved
+  domain *possible; // the colors some placement allows
+  unsigned char *prefix, *prefix_gap; // (blocks + 1) × (cells + 1)
+  unsigned char *suffix, *suffix_gap;
+  unsigned int *run; // how many cells from a point on allow a color
+  int *cover; // placements of a block, as differences
+  domain *first, *second; // the solutions found so far
+  uint64_t limit, count;
+} Solver;
+
+unsigned int ncolors;
+Color colors[MAX_COLORS + 1];
+unsigned char *leftcolors, *topcolors;
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static inline bool is_letter(char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+int read_colors(FILE *file, char *c)
+// Read the color declarations that may follow the size, one per line:
+// a letter and an HTML color such as “r #ff0000”.
+// On entry, *c is the first char after the size; on return, the first char
+// after the declarations.
+// Return the number of colors, or -1 on invalid input.
+{
+  unsigned int i, rgb;
+  int digit;
+  char name;
+
+  ncolors = 0;
+  while (is_letter(*c))
+  {
+    name = *c;
+    if (ncolors == MAX_COLORS || find_color(name) != 0)
+      return -1;
+    do
+      *c = freadchar(file);
+    while (*c == ' ' || *c == '\t');
+    if (*c != '#')
+      return -1;
+    rgb = 0;
+    for (i = 0; i < 6; i++)
+    {
+      digit = hex_value(freadchar(file));
+      if (digit < 0)
+        return -1;
+      rgb = rgb * 16 + digit;
+    }
+    do
+      *c = freadchar(file);
+    while (*c == ' ' || *c == '\t');
+    if (*c != '\r' && *c != '\n')
+      return -1;
+    while (*c != '\0' && *c <= ' ')
+      *c = freadchar(file);
+    ncolors++;
+    colors[ncolors].name = name;
+    colors[ncolors].rgb = rgb;
+  }
+  return ncolors;
+}
+
+unsigned int find_color(char name)
+// Return the index of the color with this name, or 0 if there's none.
+{
+  unsigned int i;
+  for (i = 1; i <= ncolors; i++)
+    if (colors[i].name == name)
+      return i;
+  return 0;
+}
+
+void setup_colors(void)
+{
+  leftcolors = alloc(left_offset(ysize));
+  topcolors = alloc(top_offset(xsize));
+}
+
+void free_colors(void)
+{
+  free(leftcolors);
+  free(topcolors);
+  leftcolors = topcolors = NULL;
+  ncolors = 0;
+}
+
+static unsigned int get_line(unsigned int line, unsigned int *first, unsigned int *step, const unsigned int **border, const unsigned char **blockcolors)
+// Return the number of cells of the line, and tell where they and the blocks are.
+{
+  if (line < ysize)
+  {
+    *first = line * xsize;
+    *step = 1;
+    *border = leftborder + left_offset(line);
+    *blockcolors = leftcolors + left_offset(line);
+    return xsize;
+  }
+  line -= ysize;
+  *first = line;
+  *step = xsize;
+  *border = topborder + top_offset(line);
+  *blockcolors = topcolors + top_offset(line);
+  return ysize;
+}
+
+static inline unsigned int crossing_line(unsigned int line, unsigned int i)
+// Return the line that crosses the line at its ith cell.
+{
+  return line < ysize ? ysize + i : i;
+}
+
+static void measure_runs(Solver *solver, unsigned int n, domain color)
+// For every cell, count the cells from it on that allow the color.
+{
+  unsigned int i;
+  solver->run[n] = 0;
+  for (i = n; i-- > 0; )
+    solver->run[i] = (solver->line[i] & color) ? solver->run[i + 1] + 1 : 0;
+}
+
+static bool solve_color_line(Solver *solver, domain *cells, unsigned int line)
+// Narrow down the colors of the cells of the line to those that some
+// placement of its blocks allows, and queue the crossing lines of the cells
+// that have changed.
+// Return false if there's no placement at all.
+{
+  const unsigned int *border;
+  const unsigned char *blockcolors;
+  unsigned int n, k, w, i, j, len, first, step, end;
+  bool same;
+  domain d;
+  int acc;
+
+  n = get_line(line, &first, &step, &border, &blockcolors);
+  for (k = 0; k < n && border[k] != 0; k++)
+    ;
+  for (i = 0; i < n; i++)
+    solver->line[i] = cells[first + i * step];
+  w = n + 1;
+#define AT(table, j, i) (table)[(j) * w + (i)]
+
+  // Do the first j blocks fit into the first i cells?
+  for (j = 0; j <= k; j++)
+  {
+    len = j > 0 ? border[j - 1] : 0;
+    if (j > 0)
+      measure_runs(solver, n, color_bit(blockcolors[j - 1]));
+    same = j > 1 && blockcolors[j - 2] == blockcolors[j - 1];
+    for (i = 0; i <= n; i++)
+    {
+      if (i == 0)
+        AT(solver->prefix_gap, j, i) = j == 0;
+      else
+        AT(solver->prefix_gap, j, i) = AT(solver->prefix, j, i - 1) && (solver->line[i - 1] & BACKGROUND);
+      AT(solver->prefix, j, i) = AT(solver->prefix_gap, j, i);
+      if (j > 0 && i >= len && solver->run[i - len] >= len)
+      {
+        if (same ? AT(solver->prefix_gap, j - 1, i - len) : AT(solver->prefix, j - 1, i - len))
+          AT(solver->prefix, j, i) = true;
+      }
+    }
+  }
+  if (!AT(solver->prefix, k, n))
+    return false;
+
+  // Do the blocks from the jth on fit into the cells from the ith on?
+  for (j = k + 1; j-- > 0; )
+  {
+    len = j < k ? border[j] : 0;
+    if (j < k)
+      measure_runs(solver, n, color_bit(blockcolors[j]));
+    same = j + 1 < k && blockcolors[j + 1] == blockcolors[j];
+    for (i = n + 1; i-- > 0; )
+    {
+      if (i == n)
+        AT(solver->suffix_gap, j, i) = j == k;
+      else
+        AT(solver->suffix_gap, j, i) = AT(solver->suffix, j, i + 1) && (solver->line[i] & BACKGROUND);
+      AT(solver->suffix, j, i) = AT(solver->suffix_gap, j, i);
+      if (j < k && i + len <= n && solver->run[i] >= len)
+      {
+        if (same ? AT(solver->suffix_gap, j + 1, i + len) : AT(solver->suffix, j + 1, i + len))
+          AT(solver->suffix, j, i) = true;
+      }
+    }
+  }
+
+  memset(solver->possible, 0, n * sizeof(domain));
+  for (i = 0; i < n; i++)
+  if (solver->line[i] & BACKGROUND)
+  {
+    for (j = 0; j <= k; j++)
+      if (AT(solver->prefix, j, i) && AT(solver->suffix, j, i + 1))
+      {
+        solver->possible[i] = BACKGROUND;
+        break;
+      }
+  }
+  for (j = 0; j < k; j++)
+  {
+    len = border[j];
+    d = color_bit(blockcolors[j]);
+    measure_runs(solver, n, d);
+    memset(solver->cover, 0, w * sizeof(int));
+    for (i = 0; i + len <= n; i++)
+    {
+      end = i + len;
+      if (solver->run[i] < len)
+        continue;
+      if ((j > 0 && blockcolors[j - 1] == blockcolors[j]) ? !AT(solver->prefix_gap, j, i) : !AT(solver->prefix, j, i))
+        continue;
+      if ((j + 1 < k && blockcolors[j + 1] == blockcolors[j]) ? !AT(solver->suffix_gap, j + 1, end) : !AT(solver->suffix, j + 1, end))
+        continue;
+      solver->cover[i]++;
+      solver->cover[end]--;
+    }
+    for (i = 0, acc = 0; i < n; i++)
+    {
+      acc += solver->cover[i];
+      if (acc > 0)
+        solver->possible[i] |= d;
+    }
+  }
+#undef AT
+
+  for (i = 0; i < n; i++)
+  {
+    d = solver->line[i] & solver->possible[i];
+    if (d == 0)
+      return false;
+    if (d != solver->line[i])
+    {
+      cells[first + i * step] = d;
+      put_into_queue(solver->queue, crossing_line(line, i), 0);
+    }
+  }
+  return true;
+}
+
+static bool propagate(Solver *solver, domain *cells)
+// Solve the queued lines until nothing changes.
+// Return false on a contradiction.
+{
+  unsigned int line;
+
+  count_stat(STAT_SHAKES);
+  while (!is_queue_empty(solver->queue))
+  {
+    line = get_from_queue(solver->queue);
+    count_stat(STAT_LINE_SOLVES);
+    if (!solve_color_line(solver, cells, line))
+    {
+      reset_queue(solver->queue);
+      return false;
+    }
+  }
+  return true;
+}
+
+static unsigned int pick_cell(const domain *cells)
+// Return an unknown cell with the fewest colors left, or NO_CELL.
+{
+  unsigned int i, best = NO_CELL, size, best_size = MAX_COLORS + 2;
+  domain d;
+
+  for (i = 0; i < vsize; i++)
+  if (!is_color_known(cells[i]))
+  {
+    for (size = 0, d = cells[i]; d != 0; d &= d - 1)
+      size++;
+    if (size < best_size)
+    {
+      best = i;
+      best_size = size;
+      if (size == 2)
+        break;
+    }
+  }
+  return best;
+}
+
+static void search_colors(Solver *solver, domain *cells)
+// Look for solutions that agree with the cells, until there are enough.
+// The cells are left as propagation leaves them.
+{
+  ArenaMark mark;
+  domain *copy, rest;
+  unsigned int n;
+
+  count_stat(STAT_NODES);
+  if (charge_node() || !propagate(solver, cells))
+    return;
+  n = pick_cell(cells);
+  if (n == NO_CELL)
+  {
+    if (solver->count == 0)
+      memcpy(solver->first, cells, vsize * sizeof(domain));
+    else if (solver->count == 1 && solver->second != NULL)
+      memcpy(solver->second, cells, vsize * sizeof(domain));
+    solver->count++;
+    return;
+  }
+  mark = arena_mark(solver->arena);
+  copy = arena_alloc(solver->arena, vsize * sizeof(domain));
+  for (rest = cells[n]; rest != 0 && solver->count < solver->limit && !is_out_of_budget(); rest &= rest - 1)
+  {
+    memcpy(copy, cells, vsize * sizeof(domain));
+    copy[n] = rest & -rest;
+    put_into_queue(solver->queue, n / xsize, 0);
+    put_into_queue(solver->queue, ysize + n % xsize, 0);
+    search_colors(solver, copy);
+  }
+  arena_release(solver->arena, mark);
+}
+
+uint64_t solve_colors(domain *cells, uint64_t limit, domain *second)
+// Solve the colored puzzle.
+// Return the number of solutions, but stop counting at the limit.
+// The first solution is put into the cells, and the second one (if any)
+// into the second array, unless it's NULL. If there's none, the cells hold
+// what line solving has found.
+{
+  Solver solver;
+  domain *rowmask, *columnmask;
+  unsigned int i, j;
+  size_t size;
+
+  // The tables have a row for every block of the longest clue, plus one.
+  size = (size_t) ((lmax > tmax ? lmax : tmax) + 1) * (xysize + 1);
+  solver.arena = alloc_arena(2 * (size_t) vsize * sizeof(domain) + 4 * size);
+  solver.queue = alloc_queue();
+  solver.line = arena_alloc(solver.arena, xysize * sizeof(domain));
+  solver.possible = arena_alloc(solver.arena, xysize * sizeof(domain));
+  solver.prefix = arena_alloc(solver.arena, size);
+  solver.prefix_gap = arena_alloc(solver.arena, size);
+  solver.suffix = arena_alloc(solver.arena, size);
+  solver.suffix_gap = arena_alloc(solver.arena, size);
+  solver.run = arena_alloc(solver.arena, (xysize + 1) * sizeof(unsigned int));
+  solver.cover = arena_alloc(solver.arena, (xysize + 1) * sizeof(int));
+  solver.first = arena_alloc(solver.arena, vsize * sizeof(domain));
+  solver.second = second;
+  solver.limit = limit;
+  solver.count = 0;
+
+  // A cell may only have the colors of the blocks of both its lines.
+  rowmask = arena_alloc(solver.arena, ysize * sizeof(domain));
+  columnmask = arena_alloc(solver.arena, xsize * sizeof(domain));
+  for (i = 0; i < ysize; i++)
+    for (rowmask[i] = BACKGROUND, j = 0; j < xsize && leftborder[left_offset(i) + j] != 0; j++)
+      rowmask[i] |= color_bit(leftcolors[left_offset(i) + j]);
+  for (i = 0; i < xsize; i++)
+    for (columnmask[i] = BACKGROUND, j = 0; j < ysize && topborder[top_offset(i) + j] != 0; j++)
+      columnmask[i] |= color_bit(topcolors[top_offset(i) + j]);
+  for (i = 0; i < vsize; i++)
+    cells[i] = rowmask[i / xsize] & columnmask[i % xsize];
+  for (i = 0; i < xpysize; i++)
+    put_into_queue(solver.queue, i, 0);
+
+  search_colors(&solver, cells);
+  if (solver.count > 0)
+    memcpy(cells, solver.first, vsize * sizeof(domain));
+  free_queue(solver.queue);
+  free_arena(solver.arena);
+  return solver.count;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
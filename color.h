@@ -0,0 +1,73 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef NONOGRAM_COLOR_H
+#define NONOGRAM_COLOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define MAX_COLORS 15 // not counting the background
+
+typedef uint16_t domain; // the colors a cell may still have
+#define BACKGROUND 1 // bit 0; bit c stands for color c
+
+typedef struct
+{
+  char name; // the letter that follows the block lengths
+  unsigned int rgb; // 0xRRGGBB
+} Color;
+
+extern unsigned int ncolors; // 0 for a black and white puzzle
+extern Color colors[MAX_COLORS + 1]; // indexed from 1
+extern unsigned char *leftcolors, *topcolors; // of the blocks, laid out like the borders
+
+int read_colors(FILE*, char*);
+unsigned int find_color(char);
+void setup_colors(void);
+void free_colors(void);
+uint64_t solve_colors(domain*, uint64_t, domain*);
+
+static inline domain color_bit(unsigned int color)
+{
+  return (domain) 1 << color;
+}
+
+static inline bool is_color_known(domain d)
+{
+  return (d & (d - 1)) == 0;
+}
+
+static inline unsigned int first_color(domain d)
+// Return the lowest color of a non-empty set; 0 is the background.
+{
+  unsigned int color = 0;
+  while ((d & 1) == 0)
+    d >>= 1, color++;
+  return color;
+}
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
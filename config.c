@@ -21,19 +21,53 @@
 
 #include "autoconfig.h"
 
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "config.h"
+#include "nonogram.h"
+
+#define CLASSIFY_TIME_LIMIT 1.0 // in seconds, unless --time-limit is given
 
 Config config = {
   .color = false,
   .utf8 = false,
   .html = false,
   .xhtml = false,
-  .stats = false
+  .stats = false,
+  .threads = 1,
+  .sat = false,
+  .portfolio = false,
+  .restarts = false,
+  .local_search = false,
+  .seed_given = false,
+  .seed = 0,
+  .dimacs_file = NULL,
+  .solutions = 1,
+  .unique = false,
+  .time_limit = 0.0,
+  .node_limit = 0,
+  .trace_file = NULL,
+  .cache_dir = NULL,
+  .given_file = NULL,
+  .session = false,
+  .daemon_socket = NULL,
+  .max_clients = 16,
+  .pack_file = NULL,
+  .pack_puzzle = NULL,
+  .classify = false,
+  .checkpoint_file = NULL,
+  .checkpoint_interval = 10.0,
+  .resume_file = NULL,
+  .yield_scheduling = false,
+  .orientation = ORIENT_AUTO,
+  .max_size = MAX_SIZE
 };
 
 static void show_usage(void)
@@ -45,8 +79,45 @@ static void show_usage(void)
     "  -u, --utf-8       use UTF-8 drawing characters\n"
     "  -H, --html        HTML output\n"
     "  -X, --xhtml       XHTML output\n"
+    "  -t, --threads=N   use N threads\n"
+    "  -S, --sat         use the SAT solver instead of backtracking\n"
+    "  -P, --portfolio   race several search strategies against each other\n"
+    "  -r, --restarts[=SEED]\n"
+    "                    restart the search now and then, with random orders\n"
+    "  -L, --local-search[=SEED]\n"
+    "                    find any solution with a randomized local search\n"
+    "  -D, --dimacs=FILE write the unsolved part in the DIMACS CNF format to FILE\n"
+    "  -N, --count=N     count the solutions, up to N\n"
+    "  -U, --unique      check if the solution is unique\n"
+    "  -l, --time-limit=SECONDS\n"
+    "                    give up after SECONDS\n"
+    "  -n, --node-limit=N\n"
+    "                    give up after N search nodes\n"
+    "  -g, --given=FILE  start from the cells known in FILE\n"
+    "  -C, --cache=DIR   remember solved puzzles in DIR\n"
+    "  -i, --session     read commands that change the clues, and re-solve\n"
+    "  -d, --daemon=SOCKET\n"
+    "                    solve puzzles sent to the Unix domain SOCKET\n"
+    "  -M, --max-clients=N\n"
+    "                    let at most N clients wait for the daemon\n"
+    "  -p, --pack=FILE   solve the puzzles of a pack made by nonogram-pack\n"
+    "  -I, --puzzle=ID   solve only the puzzle of the pack with this name or index\n"
+    "  -K, --classify    line-solve briefly and report how hard the puzzle looks\n"
+    "  -k, --checkpoint=FILE\n"
+    "                    save the state of the search to FILE now and then\n"
+    "  -E, --checkpoint-every=SECONDS\n"
+    "                    save it every SECONDS (default: 10)\n"
+    "  -R, --resume=FILE resume the search from the checkpoint in FILE\n"
+    "  -Y, --yield-scheduling\n"
+    "                    solve first the lines that have been fixing the most cells\n"
+    "  -O, --orientation=auto|keep|transpose\n"
+    "                    whether to solve the puzzle with its rows and columns swapped\n"
+    "  -G, --max-size=N  accept puzzles of up to N by N cells (default: 999)\n"
 #if ENABLE_DEBUG
     "  -f, --file=FILE   validate the result using FILE\n"
+#endif
+#if ENABLE_TRACE
+    "  -T, --trace=FILE  write a binary trace to FILE\n"
 #endif
     "  -h, --help        display this help and exit\n"
     "  -v, --version     output version information and exit\n\n");
@@ -61,6 +132,48 @@ static void show_version(void)
   exit(EXIT_FAILURE);
 }
 
+static unsigned int parse_number(const char *str, const char *what, unsigned int min)
+{
+  char *end;
+  unsigned long n;
+
+  errno = 0;
+  n = strtoul(str, &end, 10);
+  if (errno != 0 || end == str || *end != '\0' || *str == '-' || n < min || n > UINT_MAX)
+  {
+    fprintf(stderr, "%s: invalid %s: %s\n", PACKAGE_NAME, what, str);
+    exit(EXIT_FAILURE);
+  }
+  return n;
+}
+
+static double parse_seconds(const char *str, const char *what)
+{
+  char *end;
+  double x;
+
+  errno = 0;
+  x = strtod(str, &end);
+  if (errno != 0 || end == str || *end != '\0' || !isfinite(x) || x <= 0.0)
+  {
+    fprintf(stderr, "%s: invalid %s: %s\n", PACKAGE_NAME, what, str);
+    exit(EXIT_FAILURE);
+  }
+  return x;
+}
+
+static Orientation parse_orientation(const char *str)
+{
+  if (strcmp(str, "auto") == 0)
+    return ORIENT_AUTO;
+  if (strcmp(str, "keep") == 0)
+    return ORIENT_KEEP;
+  if (strcmp(str, "transpose") == 0)
+    return ORIENT_TRANSPOSE;
+  fprintf(stderr, "%s: invalid orientation: %s\n", PACKAGE_NAME, str);
+  exit(EXIT_FAILURE);
+}
+
 void parse_arguments(int argc, char **argv, char **vfn)
 {
   static struct option options [] =
@@ -72,6 +185,31 @@ void parse_arguments(int argc, char **argv, char **vfn)
     { "utf-8",      0, 0, 'u' },
     { "html",       0, 0, 'H' },
     { "xhtml",      0, 0, 'X' },
+    { "threads",    1, 0, 't' },
+    { "sat",        0, 0, 'S' },
+    { "portfolio",  0, 0, 'P' },
+    { "restarts",   2, 0, 'r' },
+    { "local-search", 2, 0, 'L' },
+    { "dimacs",     1, 0, 'D' },
+    { "count",      1, 0, 'N' },
+    { "unique",     0, 0, 'U' },
+    { "time-limit", 1, 0, 'l' },
+    { "node-limit", 1, 0, 'n' },
+    { "given",      1, 0, 'g' },
+    { "cache",      1, 0, 'C' },
+    { "session",    0, 0, 'i' },
+    { "daemon",     1, 0, 'd' },
+    { "max-clients", 1, 0, 'M' },
+    { "pack",       1, 0, 'p' },
+    { "puzzle",     1, 0, 'I' },
+    { "classify",   0, 0, 'K' },
+    { "checkpoint", 1, 0, 'k' },
+    { "checkpoint-every", 1, 0, 'E' },
+    { "resume",     1, 0, 'R' },
+    { "yield-scheduling", 0, 0, 'Y' },
+    { "orientation", 1, 0, 'O' },
+    { "max-size",   1, 0, 'G' },
+    { "trace",      1, 0, 'T' },
     { "file",       0, 0, 'f' }, // XXX undocumented
     { "statistics", 0, 0, 's' }, // XXX undocumented
     { NULL,         0, 0, '\0' }
@@ -82,7 +220,7 @@ void parse_arguments(int argc, char **argv, char **vfn)
   while (true)
   {
     optindex = 0;
-    c = getopt_long(argc, argv, "vhcmuHXsf:", options, &optindex);
+    c = getopt_long(argc, argv, "vhcmuHXst:SPr::L::D:N:Ul:n:g:C:id:M:p:I:Kk:E:R:YO:G:T:f:", options, &optindex);
     if (c < 0)
       break;
     if (c == 0)
@@ -110,6 +248,102 @@ void parse_arguments(int argc, char **argv, char **vfn)
     case 'X':
       config.html = config.xhtml = true;
       break;
+    case 't':
+      config.threads = parse_number(optarg, "number of threads", 1);
+      break;
+    case 'S':
+      config.sat = true;
+      break;
+    case 'P':
+      config.portfolio = true;
+      break;
+    case 'r':
+      config.restarts = true;
+      if (optarg != NULL)
+      {
+        config.seed = parse_number(optarg, "random seed", 0);
+        config.seed_given = true;
+      }
+      break;
+    case 'L':
+      config.local_search = true;
+      if (optarg != NULL)
+      {
+        config.seed = parse_number(optarg, "random seed", 0);
+        config.seed_given = true;
+      }
+      break;
+    case 'D':
+      config.dimacs_file = optarg;
+      break;
+    case 'N':
+      config.solutions = parse_number(optarg, "number of solutions", 1);
+      break;
+    case 'U':
+      config.solutions = 2;
+      config.unique = true;
+      break;
+    case 'l':
+      config.time_limit = parse_seconds(optarg, "time limit");
+      break;
+    case 'n':
+      config.node_limit = parse_number(optarg, "node limit", 1);
+      break;
+    case 'g':
+      config.given_file = optarg;
+      break;
+    case 'C':
+      config.cache_dir = optarg;
+      break;
+    case 'i':
+      config.session = true;
+      break;
+    case 'd':
+      config.daemon_socket = optarg;
+      break;
+    case 'M':
+      config.max_clients = parse_number(optarg, "number of clients", 1);
+      break;
+    case 'p':
+      config.pack_file = optarg;
+      break;
+    case 'I':
+      config.pack_puzzle = optarg;
+      break;
+    case 'K':
+      config.classify = true;
+      break;
+    case 'k':
+      config.checkpoint_file = optarg;
+      break;
+    case 'E':
+      config.checkpoint_interval = parse_seconds(optarg, "checkpoint interval");
+      break;
+    case 'R':
+      config.resume_file = optarg;
+      break;
+    case 'Y':
+      config.yield_scheduling = true;
+      break;
+    case 'O':
+      config.orientation = parse_orientation(optarg);
+      break;
+    case 'G':
+      config.max_size = parse_number(optarg, "size", 1);
+      if (config.max_size > MAX_LARGE_SIZE)
+      {
+        fprintf(stderr, "%s: the size can't exceed %u\n", argv[0], MAX_LARGE_SIZE);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'T':
+      if (!ENABLE_TRACE)
+      {
+        fprintf(stderr, "%s: tracing support is not compiled in\n", argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      config.trace_file = optarg;
+      break;
     case 'f':
       if (ENABLE_DEBUG && optarg != NULL)
         *vfn = optarg;
@@ -127,6 +361,46 @@ void parse_arguments(int argc, char **argv, char **vfn)
     fprintf(stderr, "%s: too many arguments\n", argv[0]);
     exit(EXIT_FAILURE);
   }
+  if (config.local_search && (config.solutions > 1 || config.portfolio))
+  {
+    fprintf(stderr, "%s: the local search can't be combined with counting or the portfolio\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (config.session && (config.solutions > 1 || config.portfolio || config.local_search || config.restarts ||
+    config.given_file != NULL || config.cache_dir != NULL || config.daemon_socket != NULL || config.dimacs_file != NULL))
+  {
+    fprintf(stderr, "%s: the session can only be combined with the output, threads, SAT and limit options\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (config.pack_file != NULL && (config.session || config.daemon_socket != NULL))
+  {
+    fprintf(stderr, "%s: a pack can't be used in a session or by the daemon\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (config.pack_puzzle != NULL && config.pack_file == NULL)
+  {
+    fprintf(stderr, "%s: --puzzle needs --pack\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (config.classify && config.session)
+  {
+    fprintf(stderr, "%s: the session can't classify puzzles\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if ((config.checkpoint_file != NULL || config.resume_file != NULL) &&
+    (config.threads > 1 || config.solutions > 1 || config.sat || config.portfolio || config.local_search ||
+     config.restarts || config.session || config.daemon_socket != NULL || config.pack_file != NULL || config.classify))
+  {
+    fprintf(stderr, "%s: checkpoints need the plain backtracking search for a single solution, on a single thread\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (config.orientation == ORIENT_TRANSPOSE && (config.session || config.dimacs_file != NULL))
+  {
+    fprintf(stderr, "%s: the puzzle can't be transposed in a session or for --dimacs\n", argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (config.classify && config.time_limit == 0.0)
+    config.time_limit = CLASSIFY_TIME_LIMIT;
 }
 
 /* vim:set ts=2 sts=2 sw=2 et: */
@@ -24,6 +24,13 @@
 
 #include <stdbool.h>
 
+typedef enum
+{
+  ORIENT_AUTO,     // transpose the puzzle if its columns look costlier than its rows
+  ORIENT_KEEP,
+  ORIENT_TRANSPOSE
+} Orientation;
+
 typedef struct
 {
   bool color;  // use colors
@@ -31,6 +38,33 @@ typedef struct
   bool html;   // print HTML instead of plain text
   bool xhtml;  // print XHTML instead of plain text
   bool stats;
+  unsigned int threads;
+  bool sat;    // use the SAT solver instead of backtracking
+  bool portfolio; // race several strategies
+  bool restarts; // restart the search with random orders
+  bool local_search; // look for any solution with a stochastic local search
+  bool seed_given;
+  unsigned int seed; // for the random orders and walks
+  const char *dimacs_file;
+  unsigned int solutions; // how many solutions to look for
+  bool unique; // fail unless the solution is unique
+  double time_limit; // in seconds, or 0
+  unsigned int node_limit; // or 0
+  const char *trace_file;
+  const char *cache_dir; // where solved puzzles are kept, or NULL
+  const char *given_file; // cells known in advance, or NULL
+  bool session; // re-solve the puzzle as commands change its clues
+  const char *daemon_socket; // serve puzzles on this socket, or NULL
+  unsigned int max_clients; // how many clients the daemon keeps waiting
+  const char *pack_file; // solve the puzzles of this pack, or NULL
+  const char *pack_puzzle; // only the one with this name or index, or NULL
+  bool classify; // only line-solve for a while, and report how hard the puzzle looks
+  const char *checkpoint_file; // where to save the state of the search, or NULL
+  double checkpoint_interval; // in seconds
+  const char *resume_file; // the checkpoint to resume the search from, or NULL
+  bool yield_scheduling; // order the lines by their learned yield
+  Orientation orientation; // whether to solve the puzzle transposed
+  unsigned int max_size; // the largest width or height accepted
 } Config;
 
 extern Config config;
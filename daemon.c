@@ -0,0 +1,312 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Solve puzzles sent over a Unix domain socket.
+ *
+ * A request is a puzzle in the usual format, optionally preceded by lines
+ * that limit the effort spent on it:
+ *
+ *   time-limit SECONDS
+ *   node-limit N
+ *
+ * after which the client shuts down its side of the connection for writing.
+ * The response is whatever the solver would print to stdout and stderr,
+ * followed by a line “Exit status: N”.
+ *
+ * The solver keeps the puzzle in globals, so the requests are served one at a
+ * time, each of them by the whole thread pool. A separate thread accepts the
+ * connections and queues them; clients that do not fit in the queue are
+ * turned away at once.
+ */
+
+#include "autoconfig.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "daemon.h"
+#include "memory.h"
+
+#define CLIENT_TIMEOUT 10 // seconds a client may keep us waiting
+
+typedef struct
+{
+  int *fds; // a ring of connections waiting to be served
+  unsigned int size, head, count;
+  pthread_mutex_t mutex;
+  pthread_cond_t nonempty;
+} Backlog;
+
+static Backlog backlog = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .nonempty = PTHREAD_COND_INITIALIZER
+};
+
+static int server_fd = -1;
+static const char *socket_path = NULL;
+
+static void remove_socket(void)
+{
+  if (socket_path != NULL)
+    unlink(socket_path);
+}
+
+static void handle_sigterm()
+{
+  remove_socket();
+  _exit(EXIT_SUCCESS);
+}
+
+static void setup_signals(void)
+{
+  signal(SIGPIPE, SIG_IGN);
+#ifdef HAVE_SIGACTION
+  struct sigaction act;
+  act.sa_handler = handle_sigterm;
+  act.sa_flags = 0;
+  sigemptyset(&act.sa_mask);
+  sigaction(SIGTERM, &act, NULL);
+#endif
+}
+
+static void open_socket(const char *path)
+// Listen on the socket, replacing one left behind by a daemon that is gone.
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+  {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    exit(EXIT_FAILURE);
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+  {
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0)
+    {
+      fprintf(stderr, "Another daemon is listening on %s!\n", path);
+      exit(EXIT_FAILURE);
+    }
+    if (fd >= 0)
+      close(fd);
+    unlink(path);
+  }
+
+  server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server_fd < 0 ||
+    bind(server_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+    listen(server_fd, SOMAXCONN) < 0)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  socket_path = path;
+  atexit(remove_socket);
+}
+
+static void set_timeouts(int fd)
+// Don't let a client that neither talks nor listens hold up everyone else.
+{
+  struct timeval timeout = { .tv_sec = CLIENT_TIMEOUT, .tv_usec = 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static void turn_away(int fd)
+// Reply without reading the puzzle. The request is drained first, as closing
+// a socket with unread data would reset the connection before the client
+// gets to see the reply.
+{
+  char buffer[4096];
+  ssize_t n;
+
+  do
+    n = read(fd, buffer, sizeof(buffer));
+  while (n > 0 || (n < 0 && errno == EINTR));
+  dprintf(fd, "Too many clients!\nExit status: %d\n", EXIT_BUSY);
+  close(fd);
+}
+
+static void *accept_clients(void *arg)
+{
+  int fd;
+  bool queued;
+
+  (void) arg;
+  while (true)
+  {
+    fd = accept(server_fd, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno != EINTR && errno != ECONNABORTED)
+        perror("accept");
+      continue;
+    }
+    set_timeouts(fd);
+    pthread_mutex_lock(&backlog.mutex);
+    queued = backlog.count < backlog.size;
+    if (queued)
+    {
+      backlog.fds[(backlog.head + backlog.count) % backlog.size] = fd;
+      backlog.count++;
+      pthread_cond_signal(&backlog.nonempty);
+    }
+    pthread_mutex_unlock(&backlog.mutex);
+    if (!queued)
+      turn_away(fd);
+  }
+  return NULL;
+}
+
+static int next_client(void)
+{
+  int fd;
+
+  pthread_mutex_lock(&backlog.mutex);
+  while (backlog.count == 0)
+    pthread_cond_wait(&backlog.nonempty, &backlog.mutex);
+  fd = backlog.fds[backlog.head];
+  backlog.head = (backlog.head + 1) % backlog.size;
+  backlog.count--;
+  pthread_mutex_unlock(&backlog.mutex);
+  return fd;
+}
+
+static inline double clamp_seconds(double requested, double limit)
+{
+  if (limit > 0.0 && (requested <= 0.0 || requested > limit))
+    return limit;
+  return requested;
+}
+
+static inline unsigned int clamp_nodes(unsigned int requested, unsigned int limit)
+{
+  if (limit > 0 && (requested == 0 || requested > limit))
+    return limit;
+  return requested;
+}
+
+static bool read_limits(FILE *file, const RequestLimits *defaults, RequestLimits *limits)
+// Read the header lines of a request. The client may lower the daemon's own
+// limits, but not raise them.
+{
+  char line[80];
+  double seconds;
+  unsigned int nodes;
+  int c;
+
+  *limits = *defaults;
+  while ((c = getc(file)) != EOF && isalpha(c))
+  {
+    ungetc(c, file);
+    if (fgets(line, sizeof(line), file) == NULL)
+      return false;
+    if (sscanf(line, "time-limit %lf", &seconds) == 1 && seconds > 0.0)
+      limits->time_limit = clamp_seconds(seconds, defaults->time_limit);
+    else if (sscanf(line, "node-limit %u", &nodes) == 1 && nodes > 0)
+      limits->node_limit = clamp_nodes(nodes, defaults->node_limit);
+    else
+      return false;
+  }
+  if (c != EOF)
+    ungetc(c, file);
+  return true;
+}
+
+static void serve_client(int fd, const RequestLimits *defaults, RequestHandler handle)
+// Solve one puzzle, with stdout and stderr redirected to the client.
+{
+  static int saved_stdout = -1, saved_stderr = -1;
+  RequestLimits limits;
+  FILE *file;
+  int rc;
+
+  if (saved_stdout < 0)
+  {
+    saved_stdout = dup(STDOUT_FILENO);
+    saved_stderr = dup(STDERR_FILENO);
+  }
+  file = fdopen(fd, "r");
+  if (file == NULL)
+  {
+    close(fd);
+    return;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+
+  if (read_limits(file, defaults, &limits))
+    rc = handle(file, &limits);
+  else
+  {
+    fprintf(stderr, "Invalid request header!\n");
+    rc = EXIT_FAILURE;
+  }
+  printf("Exit status: %d\n", rc);
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(saved_stdout, STDOUT_FILENO);
+  dup2(saved_stderr, STDERR_FILENO);
+  fclose(file);
+}
+
+void run_daemon(const char *path, unsigned int max_clients, const RequestLimits *defaults, RequestHandler handle)
+// Serve requests until killed. Besides the one being served, at most
+// max_clients connections are kept waiting.
+{
+  pthread_t thread;
+
+  open_socket(path);
+  setup_signals();
+  backlog.size = max_clients;
+  backlog.fds = alloc(max_clients * sizeof(int));
+  if (pthread_create(&thread, NULL, accept_clients, NULL) != 0)
+  {
+    fprintf(stderr, "Cannot start the daemon thread!\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_detach(thread);
+  while (true)
+    serve_client(next_client(), defaults, handle);
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,666 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Stochastic local search.
+ *
+ * Every row is kept as a valid placement of its blocks, consistent with the
+ * cells known from line solving, so only the columns can violate their
+ * clues. They are repaired in the spirit of WalkSAT (Selman, Kautz and Cohen,
+ * “Noise Strategies for Improving Local Search”, 1994): a violated column is
+ * picked at random, and a block of some row is shifted by one cell across it,
+ * usually the shift that brings the columns closest to their clues.
+ *
+ * How far a column is from its clues is measured as the number of its cells
+ * that would have to be flipped to make it valid. Along with it, a dynamic
+ * program much like the line solver's finds how flipping any single cell
+ * would change that number, so that every possible shift can be weighed in
+ * constant time.
+ *
+ * This never proves that there is no solution, but it can find one in grids
+ * that are far too large or too ambiguous for backtracking.
+ */
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "budget.h"
+#include "local.h"
+#include "memory.h"
+#include "random.h"
+#include "stats.h"
+#include "task.h"
+
+#define NOISE_PERCENT 10 // how often to make a random move instead of the best one
+#define SAMPLE_SIZE 4 // how many rows to look at for a move, at least
+#define CHECK_INTERVAL 1024 // moves between checks whether to stop
+#define INFINITE_COST (UINT_MAX / 4)
+#define NO_BLOCK ((unsigned int)-1)
+#define NOT_VIOLATED ((unsigned int)-1)
+
+typedef struct
+// What all the walks share
+{
+  const bit *initial; // the partly solved picture; its known cells never change
+  unsigned int *first_block; // of every row, and the end
+  unsigned int *rows; // with an unknown cell, for every column
+  unsigned int *first_row; // of every column in rows, and the end
+} Layout;
+
+typedef struct
+{
+  unsigned int row, block, start; // where to move the block
+  int change; // of the cost
+} Move;
+
+typedef struct
+// The best move found so far, and one picked at random
+{
+  Move best, any;
+  unsigned int nbest, nany;
+} Choice;
+
+typedef struct
+// Scratch space for analyse_column()
+{
+  unsigned int *forward, *backward; // best costs of the cells before and after a point
+  unsigned int *wrong; // how many cells before a point are empty
+  unsigned int *values; // best costs of the placements of a block
+  unsigned int *queue;
+  unsigned int *best_empty, *best_filled; // best costs with a cell empty or filled
+} ColumnSpace;
+
+typedef struct
+// Scratch space for place_row() and weigh_block()
+{
+  unsigned char *placeable;
+  unsigned int *empty; // how many cells before a point are known to be empty
+  int *changes; // sums of change over the cells before a point
+  bit *old_row;
+  unsigned int *candidates; // rows
+} RowSpace;
+
+typedef struct
+{
+  const Layout *layout;
+  bit *bits;
+  unsigned int *start; // where every block begins
+  unsigned int *owner; // the block that covers every cell, or NO_BLOCK
+  signed char *change; // how flipping every cell would change the cost of its column
+  unsigned int *cost; // of every column
+  unsigned int *violated; // columns with a non-zero cost
+  unsigned int *position; // of every column in violated, or NOT_VIOLATED
+  unsigned int nviolated;
+  ColumnSpace column_space;
+  RowSpace row_space;
+  uint64_t random;
+  const atomic_bool *stop;
+  atomic_bool *found; // whether any walk has succeeded
+  bool success;
+} Walk;
+
+static inline unsigned int block_size(unsigned int row, unsigned int t)
+{
+  return leftborder[left_offset(row) + t];
+}
+
+static inline void lower(unsigned int *x, unsigned int value)
+{
+  if (value < *x)
+    *x = value;
+}
+
+static void analyse_column(Walk *walk, unsigned int column)
+// Find how many cells of the column have to be flipped to make it match its
+// clues, and how flipping any single cell would change that.
+{
+  const unsigned int *clue = topborder + top_offset(column);
+  const bit *bits = walk->bits + column;
+  ColumnSpace *space = &walk->column_space;
+  unsigned int *wrong = space->wrong, *values = space->values, *queue = space->queue;
+  unsigned int *best_empty = space->best_empty, *best_filled = space->best_filled;
+  unsigned int n = ysize, k, t, p, c, end, head, tail, best, cost;
+  unsigned int *f, *b;
+
+  for (k = 0; clue[k] != 0; k++)
+    ;
+  wrong[0] = 0;
+  for (p = 0; p < n; p++)
+    wrong[p + 1] = wrong[p] + (bits[p * xsize] == O);
+  // forward[t * (n + 1) + p]: the cells before p hold exactly t blocks,
+  // and a block may start at p
+  for (p = 0; p < (k + 1) * (n + 1); p++)
+    space->forward[p] = INFINITE_COST;
+  space->forward[0] = 0;
+  for (p = 0; p < n; p++)
+  for (t = 0, f = space->forward; t <= k; t++, f += n + 1)
+  if (f[p] < INFINITE_COST)
+  {
+    lower(f + p + 1, f[p] + (bits[p * xsize] == X));
+    if (t == k || (end = p + clue[t]) > n)
+      continue;
+    cost = f[p] + wrong[end] - wrong[p];
+    if (end == n)
+      lower(f + n + 1 + n, cost);
+    else
+      lower(f + n + 1 + end + 1, cost + (bits[end * xsize] == X));
+  }
+  // backward[t * (n + 1) + p]: the same for the cells from p on
+  for (t = 0, b = space->backward; t <= k; t++, b += n + 1)
+    b[n] = t == k ? 0 : INFINITE_COST;
+  for (p = n; p-- > 0; )
+  for (t = 0, b = space->backward; t <= k; t++, b += n + 1)
+  {
+    b[p] = (bits[p * xsize] == X) + b[p + 1];
+    if (t == k || (end = p + clue[t]) > n)
+      continue;
+    if (end == n)
+      cost = t + 1 == k ? 0 : INFINITE_COST;
+    else
+      cost = (bits[end * xsize] == X) + b[n + 1 + end + 1];
+    lower(b + p, cost + wrong[end] - wrong[p]);
+  }
+  best = space->forward[k * (n + 1) + n];
+  for (p = 0; p < n; p++)
+  {
+    best_empty[p] = INFINITE_COST;
+    best_filled[p] = INFINITE_COST;
+    for (t = 0; t <= k; t++)
+      lower(best_empty + p, space->forward[t * (n + 1) + p] + (bits[p * xsize] == X) + space->backward[t * (n + 1) + p + 1]);
+  }
+  for (t = 0; t < k; t++)
+  {
+    c = clue[t];
+    f = space->forward + t * (n + 1);
+    b = space->backward + (t + 1) * (n + 1);
+    // values[s]: the best cost with block t starting at s
+    for (p = 0; p + c <= n; p++)
+    {
+      end = p + c;
+      values[p] = f[p] + wrong[end] - wrong[p];
+      if (end == n)
+        values[p] += t + 1 == k ? 0 : INFINITE_COST;
+      else
+      {
+        values[p] += (bits[end * xsize] == X) + b[end + 1];
+        lower(best_empty + end, values[p]);
+      }
+    }
+    // The cell p is filled by block t if it starts between p - c + 1 and p;
+    // take the minimum over that sliding window.
+    head = tail = 0;
+    for (p = 0; p < n; p++)
+    {
+      if (p + c <= n)
+      {
+        while (tail > head && values[queue[tail - 1]] >= values[p])
+          tail--;
+        queue[tail++] = p;
+      }
+      while (queue[head] + c <= p)
+        head++;
+      lower(best_filled + p, values[queue[head]]);
+    }
+  }
+  for (p = 0; p < n; p++)
+  {
+    // Flipping the cell costs one more (or one less) in every placement,
+    // depending on whether it matches.
+    cost = bits[p * xsize] == X ? best_empty[p] : best_filled[p];
+    walk->change[p * xsize + column] = cost <= best ? -1 : cost == best + 1 ? 0 : 1;
+  }
+  walk->cost[column] = best;
+}
+
+static void update_column(Walk *walk, unsigned int column)
+{
+  unsigned int i, last;
+
+  analyse_column(walk, column);
+  if (walk->cost[column] > 0 && walk->position[column] == NOT_VIOLATED)
+  {
+    walk->position[column] = walk->nviolated;
+    walk->violated[walk->nviolated++] = column;
+  }
+  else if (walk->cost[column] == 0 && walk->position[column] != NOT_VIOLATED)
+  {
+    i = walk->position[column];
+    last = walk->violated[--walk->nviolated];
+    walk->violated[i] = last;
+    walk->position[last] = i;
+    walk->position[column] = NOT_VIOLATED;
+  }
+}
+
+static bool place_row(Walk *walk, unsigned int row)
+// Place the blocks of the row at random, consistently with the known cells.
+// Return false if that's impossible.
+{
+  const bit *known = walk->layout->initial + row * xsize;
+  bit *bits = walk->bits + row * xsize;
+  unsigned int *owner = walk->owner + row * xsize;
+  unsigned int first = walk->layout->first_block[row];
+  unsigned int k = walk->layout->first_block[row + 1] - first;
+  unsigned int *empty = walk->row_space.empty;
+  unsigned char *placeable = walk->row_space.placeable;
+  unsigned int t, p, q, c, n, from, end;
+  bool reachable;
+
+  // empty[p]: how many cells before p are known to be empty
+  empty[0] = 0;
+  for (p = 0; p < xsize; p++)
+    empty[p + 1] = empty[p] + (known[p] == O);
+  // end: just past the last cell known to be filled
+  for (end = xsize; end > 0 && known[end - 1] != X; end--)
+    ;
+  if (k == 0 && end > 0)
+    return false;
+  // placeable[t * (xsize + 1) + p]: block t can start at p, and the blocks
+  // after it can still be placed
+  for (t = k; t-- > 0; )
+  {
+    unsigned char *here = placeable + t * (xsize + 1);
+    const unsigned char *next = placeable + (t + 1) * (xsize + 1);
+    c = block_size(row, t);
+    reachable = false; // whether the next block can start at or after p + c + 1
+    for (p = xsize + 1; p-- > 0; )
+    {
+      here[p] = false;
+      if (t + 1 < k && p + c + 1 < xsize)
+        reachable = next[p + c + 1] || (known[p + c + 1] != X && reachable);
+      if (p + c > xsize || empty[p + c] != empty[p])
+        continue;
+      if (p + c < xsize && known[p + c] == X)
+        continue;
+      here[p] = t + 1 < k ? reachable : p + c >= end;
+    }
+  }
+  for (p = 0; p < xsize; p++)
+  {
+    if (known[p] == Q)
+      bits[p] = O;
+    owner[p] = NO_BLOCK;
+  }
+  from = 0;
+  for (t = 0; t < k; t++)
+  {
+    const unsigned char *here = placeable + t * (xsize + 1);
+    c = block_size(row, t);
+    // Pick a start uniformly from those that don't skip a known filled cell.
+    n = q = 0;
+    for (p = from; p < xsize; p++)
+    {
+      if (here[p] && random_below(&walk->random, ++n) == 0)
+        q = p;
+      if (known[p] == X)
+        break;
+    }
+    if (n == 0)
+      return false;
+    walk->start[first + t] = q;
+    for (p = q; p < q + c; p++)
+    {
+      bits[p] = X;
+      owner[p] = first + t;
+    }
+    from = q + c + 1;
+  }
+  return true;
+}
+
+static void consider_move(Walk *walk, Choice *choice, Move move)
+{
+  if (choice->nbest == 0 || move.change < choice->best.change)
+  {
+    choice->best = move;
+    choice->nbest = 1;
+  }
+  else if (move.change == choice->best.change && random_below(&walk->random, ++choice->nbest) == 0)
+    choice->best = move;
+  if (random_below(&walk->random, ++choice->nany) == 0)
+    choice->any = move;
+}
+
+static void weigh_block(Walk *walk, unsigned int row, unsigned int block, unsigned int column, Choice *choice)
+// Consider every place between the neighbours of the block where it would
+// flip the cell of the row in the column.
+{
+  const unsigned int *first = walk->layout->first_block;
+  const bit *known = walk->layout->initial + row * xsize;
+  const signed char *change = walk->change + row * xsize;
+  unsigned int *empty = walk->row_space.empty;
+  int *sums = walk->row_space.changes;
+  unsigned int t = block - first[row], c = block_size(row, t), s = walk->start[block];
+  unsigned int lo, hi, p, from, to, first_x = xsize, last_x = 0;
+  bool covered = s <= column && column < s + c;
+  Move move = { row, block, 0, 0 };
+  int old;
+
+  lo = t == 0 ? 0 : walk->start[block - 1] + block_size(row, t - 1) + 1;
+  hi = block + 1 == first[row + 1] ? xsize - c : walk->start[block + 1] - c - 1;
+  sums[0] = 0;
+  empty[0] = 0;
+  for (p = lo; p < hi + c; p++)
+  {
+    sums[p - lo + 1] = sums[p - lo] + change[p];
+    empty[p - lo + 1] = empty[p - lo] + (known[p] == O);
+    if (known[p] == X)
+    {
+      if (first_x == xsize)
+        first_x = p;
+      last_x = p;
+    }
+  }
+  old = sums[s + c - lo] - sums[s - lo];
+  for (p = lo; p <= hi; p++)
+  {
+    if ((p <= column && column < p + c) == covered)
+      continue;
+    // It mustn't cover a cell known to be empty, nor leave out one known to be filled.
+    if (empty[p + c - lo] != empty[p - lo])
+      continue;
+    if (first_x < xsize && (p > first_x || p + c <= last_x))
+      continue;
+    // The cells covered both before and after the move don't flip.
+    from = p > s ? p : s;
+    to = p + c < s + c ? p + c : s + c;
+    move.start = p;
+    move.change = sums[p + c - lo] - sums[p - lo] + old;
+    if (from < to)
+      move.change -= 2 * (sums[to - lo] - sums[from - lo]);
+    consider_move(walk, choice, move);
+  }
+}
+
+static void weigh_row(Walk *walk, unsigned int row, unsigned int column, Choice *choice)
+// Consider the moves of the blocks that could flip the cell in the column:
+// the block that covers it, or else the blocks on either side of it.
+{
+  const unsigned int *first = walk->layout->first_block;
+  unsigned int lo = first[row], hi = first[row + 1], mid;
+
+  if (walk->owner[row * xsize + column] != NO_BLOCK)
+  {
+    weigh_block(walk, row, walk->owner[row * xsize + column], column, choice);
+    return;
+  }
+  // Find the first block that starts after the column.
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (walk->start[mid] < column)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo > first[row])
+    weigh_block(walk, row, lo - 1, column, choice);
+  if (lo < first[row + 1])
+    weigh_block(walk, row, lo, column, choice);
+}
+
+static void move_block(Walk *walk, Move move)
+{
+  unsigned int c = block_size(move.row, move.block - walk->layout->first_block[move.row]);
+  unsigned int s = walk->start[move.block], p = move.start;
+  unsigned int base = move.row * xsize, j;
+
+  for (j = s; j < s + c; j++)
+  {
+    walk->bits[base + j] = O;
+    walk->owner[base + j] = NO_BLOCK;
+  }
+  for (j = p; j < p + c; j++)
+  {
+    walk->bits[base + j] = X;
+    walk->owner[base + j] = move.block;
+  }
+  walk->start[move.block] = p;
+  for (j = s < p ? s : p; j < (s > p ? s : p) + c; j++)
+  if ((s <= j && j < s + c) != (p <= j && j < p + c))
+    update_column(walk, j);
+}
+
+static void replace_row(Walk *walk, unsigned int row)
+// Place the row anew, and update the columns that have changed.
+{
+  bit *bits = walk->bits + row * xsize;
+  unsigned int j;
+
+  memcpy(walk->row_space.old_row, bits, xsize * sizeof(bit));
+  place_row(walk, row);
+  for (j = 0; j < xsize; j++)
+  if (bits[j] != walk->row_space.old_row[j])
+    update_column(walk, j);
+}
+
+static bool should_stop(const Walk *walk)
+{
+  if (atomic_load_explicit(walk->found, memory_order_relaxed))
+    return true;
+  if (walk->stop != NULL && atomic_load_explicit(walk->stop, memory_order_relaxed))
+    return true;
+  return false;
+}
+
+static void walk_task(void *arg)
+{
+  Walk *walk = arg;
+  const Layout *layout = walk->layout;
+  unsigned int *candidates = walk->row_space.candidates;
+  unsigned int column, row, nrows, ncandidates, i, j;
+  const unsigned int *rows;
+  uint64_t count = 0;
+  Choice choice;
+
+  walk->nviolated = 0;
+  for (i = 0; i < ysize; i++)
+  if (!place_row(walk, i))
+    return; // line solving should have caught that
+  for (j = 0; j < xsize; j++)
+  {
+    walk->position[j] = NOT_VIOLATED;
+    update_column(walk, j);
+  }
+  while (walk->nviolated > 0)
+  {
+    if (count % CHECK_INTERVAL == 0 && should_stop(walk))
+      break;
+    if (charge_node())
+      break;
+    count++;
+    column = walk->violated[random_below(&walk->random, walk->nviolated)];
+    rows = layout->rows + layout->first_row[column];
+    nrows = layout->first_row[column + 1] - layout->first_row[column];
+    if (nrows == 0)
+      break; // a column that line solving hasn't caught; hopeless
+    // Look at a few of the rows where flipping the cell would help the column.
+    ncandidates = 0;
+    for (i = 0; i < nrows; i++)
+    if (walk->change[rows[i] * xsize + column] < 0)
+      candidates[ncandidates++] = rows[i];
+    if (ncandidates == 0)
+    {
+      memcpy(candidates, rows, nrows * sizeof(unsigned int));
+      ncandidates = nrows;
+    }
+    choice.nbest = choice.nany = 0;
+    for (i = 0; (i < SAMPLE_SIZE || choice.nany == 0) && i < ncandidates; i++)
+    {
+      j = i + random_below(&walk->random, ncandidates - i);
+      row = candidates[j];
+      candidates[j] = candidates[i];
+      weigh_row(walk, row, column, &choice);
+    }
+    if (choice.nany == 0)
+      replace_row(walk, candidates[0]); // all the blocks are stuck
+    else if (random_below(&walk->random, 100) < NOISE_PERCENT)
+      move_block(walk, choice.any);
+    else
+      move_block(walk, choice.best);
+  }
+  add_stat(STAT_MOVES, count);
+  walk->success = walk->nviolated == 0;
+  if (walk->success)
+    atomic_store(walk->found, true);
+}
+
+static void setup_layout(Layout *layout, const bit *bits)
+{
+  unsigned int i, j, k;
+
+  layout->initial = bits;
+  layout->first_block = alloc((ysize + 1) * sizeof(unsigned int));
+  for (i = 0, k = 0; i < ysize; i++)
+  {
+    layout->first_block[i] = k;
+    for (j = 0; leftborder[left_offset(i) + j] != 0; j++)
+      k++;
+  }
+  layout->first_block[ysize] = k;
+  layout->rows = alloc(vsize * sizeof(unsigned int));
+  layout->first_row = alloc((xsize + 1) * sizeof(unsigned int));
+  for (j = 0, k = 0; j < xsize; j++)
+  {
+    layout->first_row[j] = k;
+    for (i = 0; i < ysize; i++)
+    if (bits[i * xsize + j] == Q)
+      layout->rows[k++] = i;
+  }
+  layout->first_row[xsize] = k;
+}
+
+static void free_layout(Layout *layout)
+{
+  free(layout->first_block);
+  free(layout->rows);
+  free(layout->first_row);
+}
+
+static void alloc_column_space(ColumnSpace *space)
+{
+  space->forward = alloc((tmax + 1) * (ysize + 1) * sizeof(unsigned int));
+  space->backward = alloc((tmax + 1) * (ysize + 1) * sizeof(unsigned int));
+  space->wrong = alloc((ysize + 1) * sizeof(unsigned int));
+  space->values = alloc(ysize * sizeof(unsigned int));
+  space->queue = alloc(ysize * sizeof(unsigned int));
+  space->best_empty = alloc(ysize * sizeof(unsigned int));
+  space->best_filled = alloc(ysize * sizeof(unsigned int));
+}
+
+static void free_column_space(ColumnSpace *space)
+{
+  free(space->forward);
+  free(space->backward);
+  free(space->wrong);
+  free(space->values);
+  free(space->queue);
+  free(space->best_empty);
+  free(space->best_filled);
+}
+
+static void alloc_row_space(RowSpace *space)
+{
+  space->placeable = alloc((lmax + 1) * (xsize + 1));
+  space->empty = alloc((xsize + 1) * sizeof(unsigned int));
+  space->changes = alloc((xsize + 1) * sizeof(int));
+  space->old_row = alloc(xsize * sizeof(bit));
+  space->candidates = alloc(ysize * sizeof(unsigned int));
+}
+
+static void free_row_space(RowSpace *space)
+{
+  free(space->placeable);
+  free(space->empty);
+  free(space->changes);
+  free(space->old_row);
+  free(space->candidates);
+}
+
+bool local_search(bit *bits, const atomic_bool *stop, uint64_t seed)
+// Run independent walks on every worker, starting from the same partly solved
+// picture, until one of them finds a solution. Give up only when asked to
+// stop, or when out of budget.
+{
+  unsigned int i, nwalks = get_worker_count();
+  Layout layout;
+  Walk *walks;
+  Task *tasks;
+  TaskGroup group;
+  atomic_bool found;
+  bool res = false;
+
+  setup_layout(&layout, bits);
+  walks = alloc(nwalks * sizeof(Walk));
+  tasks = alloc(nwalks * sizeof(Task));
+  atomic_init(&found, false);
+  for (i = 0; i < nwalks; i++)
+  {
+    walks[i].layout = &layout;
+    walks[i].bits = alloc(vsize * sizeof(bit));
+    memcpy(walks[i].bits, bits, vsize * sizeof(bit));
+    walks[i].start = alloc((layout.first_block[ysize] + 1) * sizeof(unsigned int));
+    walks[i].owner = alloc(vsize * sizeof(unsigned int));
+    walks[i].change = alloc(vsize * sizeof(signed char));
+    walks[i].cost = alloc(xsize * sizeof(unsigned int));
+    walks[i].violated = alloc(xsize * sizeof(unsigned int));
+    walks[i].position = alloc(xsize * sizeof(unsigned int));
+    alloc_column_space(&walks[i].column_space);
+    alloc_row_space(&walks[i].row_space);
+    walks[i].random = seed + i;
+    splitmix64(&walks[i].random);
+    walks[i].stop = stop;
+    walks[i].found = &found;
+    walks[i].success = false;
+  }
+  init_task_group(&group);
+  for (i = 1; i < nwalks; i++)
+    spawn_task(&group, tasks + i, walk_task, walks + i);
+  walk_task(walks);
+  sync_tasks(&group);
+  for (i = 0; i < nwalks; i++)
+  {
+    if (walks[i].success && !res)
+    {
+      memcpy(bits, walks[i].bits, vsize * sizeof(bit));
+      res = true;
+    }
+    free(walks[i].bits);
+    free(walks[i].start);
+    free(walks[i].owner);
+    free(walks[i].change);
+    free(walks[i].cost);
+    free(walks[i].violated);
+    free(walks[i].position);
+    free_column_space(&walks[i].column_space);
+    free_row_space(&walks[i].row_space);
+  }
+  free(tasks);
+  free(walks);
+  free_layout(&layout);
+  return res;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
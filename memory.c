@@ -23,8 +23,18 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#include "memory.h"
+
+typedef union
+{
+  long double f;
+  uint64_t i;
+  void *p;
+} ArenaAlign;
+
 void *alloc(size_t size)
 {
   void *tmp = calloc(1, size);
@@ -36,4 +46,99 @@ void *alloc(size_t size)
   return tmp;
 }
 
+void *resize(void *ptr, size_t size)
+// Like realloc(), but abort on failure.
+// Unlike alloc(), the new memory is not zero-filled.
+{
+  void *tmp = realloc(ptr, size);
+  if (tmp == NULL && size > 0)
+  {
+    perror(PACKAGE_NAME);
+    abort();
+  }
+  return tmp;
+}
+
+struct ArenaBlock
+{
+  ArenaBlock *next;
+  size_t size, used;
+  ArenaAlign space[];
+};
+
+static ArenaBlock *alloc_arena_block(size_t size)
+{
+  ArenaBlock *tmp = alloc(offsetof(ArenaBlock, space) + size);
+  tmp->next = NULL;
+  tmp->size = size;
+  tmp->used = 0;
+  return tmp;
+}
+
+Arena *alloc_arena(size_t block_size)
+// Allocate a stack-like arena.
+// Memory is carved out of blocks of (at least) block_size bytes,
+// which are never returned to the system until the arena is freed.
+{
+  Arena *tmp = alloc(sizeof(Arena));
+  tmp->block_size = block_size;
+  tmp->head = tmp->current = alloc_arena_block(block_size);
+  return tmp;
+}
+
+void free_arena(Arena *arena)
+{
+  ArenaBlock *block, *next;
+  for (block = arena->head; block != NULL; block = next)
+  {
+    next = block->next;
+    free(block);
+  }
+  free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+// Unlike alloc(), the returned memory is not zero-filled.
+{
+  ArenaBlock *block = arena->current;
+  void *tmp;
+
+  size = (size + sizeof(ArenaAlign) - 1) / sizeof(ArenaAlign) * sizeof(ArenaAlign);
+  if (block->used + size > block->size)
+  {
+    if (block->next != NULL && block->next->size < size)
+    {
+      // The spare blocks are too small; drop them.
+      ArenaBlock *spare, *next;
+      for (spare = block->next; spare != NULL; spare = next)
+      {
+        next = spare->next;
+        free(spare);
+      }
+      block->next = NULL;
+    }
+    if (block->next == NULL)
+      block->next = alloc_arena_block(size > arena->block_size ? size : arena->block_size);
+    block = arena->current = block->next;
+    block->used = 0;
+  }
+  tmp = (char*)block->space + block->used;
+  block->used += size;
+  return tmp;
+}
+
+ArenaMark arena_mark(Arena *arena)
+{
+  ArenaMark mark = { arena->current, arena->current->used };
+  return mark;
+}
+
+void arena_release(Arena *arena, ArenaMark mark)
+// Free everything allocated since the mark was taken.
+// Blocks are kept around for reuse.
+{
+  arena->current = mark.block;
+  arena->current->used = mark.used;
+}
+
 /* vim:set ts=2 sts=2 sw=2 et: */
@@ -22,7 +22,30 @@
 #ifndef NONOGRAM_MEMORY_H
 #define NONOGRAM_MEMORY_H
 
+#include <stddef.h>
+
 void *alloc(size_t);
+void *resize(void*, size_t);
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct
+{
+  ArenaBlock *head, *current;
+  size_t block_size;
+} Arena;
+
+typedef struct
+{
+  ArenaBlock *block;
+  size_t used;
+} ArenaMark;
+
+Arena *alloc_arena(size_t);
+void free_arena(Arena*);
+void *arena_alloc(Arena*, size_t);
+ArenaMark arena_mark(Arena*);
+void arena_release(Arena*, ArenaMark);
 
 #endif
 
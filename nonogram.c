@@ -21,8 +21,6 @@
 
 #include "autoconfig.h"
 
-#include <omp.h>
-#include <cilk/cilk.h>
 #include <assert.h>
 #include <math.h>
 #ifdef HAVE_SIGACTION
@@ -36,19 +34,196 @@
 #include <string.h>
 
 #include "io.h"
+#include "budget.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "cnf.h"
+#include "color.h"
 #include "config.h"
+#include "daemon.h"
+#include "local.h"
 #include "memory.h"
 #include "nonogram.h"
+#include "pack.h"
 #include "queue.h"
+#include "random.h"
+#include "sat.h"
+#include "session.h"
+#include "stats.h"
+#include "task.h"
 #include "term.h"
+#include "timer.h"
+#include "trace.h"
+#include "ttable.h"
+
+#define LINE_BATCH_FACTOR 4
+#define TTABLE_SIZE (1U << 18)
+
+#define NO_CELL ((unsigned int)-1)
+
+#define EXIT_INCOMPLETE 2 // the budget has run out
+
+#define RESTART_UNIT 64 // search nodes per unit of the Luby sequence
+
+#define TOUCH_MAX_WORK 1e6 // how many cells touch_line() may visit; costlier lines are settled
+
+#define ORIENT_MARGIN 2.0 // how much costlier the columns must look for the puzzle to be transposed
+
+#define YIELD_CLASSES 11 // lines of up to 1, 2, 4, ... 1024 cells
+#define YIELD_DECAY 0.25 // weight of the latest solve in the learned yields
+
+typedef struct
+// What solving a line has brought so far, for --yield-scheduling
+{
+  float rate; // cells fixed per cell that had been fixed by the crossing lines
+  unsigned int unknown; // cells left unknown by the last solve
+} LineYield;
+
+typedef struct
+// Per-worker scratch memory
+{
+  Arena *arena;
+  Queue **queues; // one for every level of nested shakes
+  unsigned int nqueues, queue_depth;
+  uint64_t *testfield;
+  unsigned int *seen, *stack; // for conflict analysis
+  LineYield *yields; // for every line
+  float class_rates[YIELD_CLASSES]; // the rates of the lines of every length
+  unsigned int epoch;
+} Workspace;
+
+typedef enum
+{
+  ORDER_ROWS,
+  ORDER_COLUMNS,
+  ORDER_REVERSE,
+  ORDER_REVERSE_COLUMNS,
+  ORDER_COUNT
+} CellOrder;
+
+typedef enum
+{
+  ENGINE_BACKTRACK,
+  ENGINE_SAT,   // hand the search over to the SAT solver
+  ENGINE_LOCAL  // stochastic local search; finds a solution, but can't count them
+} Engine;
+
+typedef struct Strategy
+// How to search. The portfolio races several strategies against each other.
+{
+  const char *name;
+  Engine engine;            // what searches the unknown cells
+  CellOrder order;          // which cells to branch on first
+  bit first;                // which value to try first
+  unsigned int evil_weight; // how much line solving favours “evil” lines
+  bool restarts;            // restart with random orders now and then
+} Strategy;
+
+static const Strategy strategies[] =
+{
+  { "default",         ENGINE_BACKTRACK, ORDER_ROWS,    O, 1, false },
+  { "sat",             ENGINE_SAT,       ORDER_ROWS,    O, 1, false },
+  { "restarts",        ENGINE_BACKTRACK, ORDER_ROWS,    O, 1, true  },
+  { "filled-first",    ENGINE_BACKTRACK, ORDER_ROWS,    X, 1, false },
+  { "columns",         ENGINE_BACKTRACK, ORDER_COLUMNS, O, 0, false },
+  { "reverse",         ENGINE_BACKTRACK, ORDER_REVERSE, X, 4, false },
+  { "columns-filled",  ENGINE_BACKTRACK, ORDER_COLUMNS, X, 4, false },
+  { "reverse-empty",   ENGINE_BACKTRACK, ORDER_REVERSE, O, 0, false },
+};
+
+// Not in the portfolio: it can neither count solutions nor prove that there
+// are none, so it would never win against an inconsistent puzzle.
+static const Strategy local_strategy =
+  { "local-search",    ENGINE_LOCAL,     ORDER_ROWS,    O, 1, false };
+
+#define STRATEGY_COUNT (sizeof(strategies) / sizeof(strategies[0]))
+#define DEFAULT_STRATEGY (strategies + 0)
+#define SAT_STRATEGY (strategies + 1)
+#define RESTART_STRATEGY (strategies + 2)
+
+typedef struct SearchBranch
+{
+  atomic_bool cancelled;
+  struct SearchBranch *parent;
+} SearchBranch;
+
+typedef struct
+{
+  bit *bits;
+  unsigned int line;
+  uint64_t *testfield;
+  uint64_t count;
+} LineJob;
+
+typedef struct Restart
+// The state of a region's search with restarts
+{
+  Region *region;
+  uint64_t random; // state of the random number generator
+  atomic_uint_fast64_t nodes; // spent in the current run
+  uint64_t budget; // for the current run
+  SearchBranch *branch; // the root of the current run
+  bit first; // the value to try first in the current run
+} Restart;
+
+typedef struct
+{
+  Picture *picture;
+  const Region *region;
+  unsigned int start, depth;
+  SearchBranch branch;
+  uint64_t *conflict;
+  uint64_t limit, count;
+  bit *second;
+} SearchJob;
+
+typedef struct PortfolioJob
+{
+  const Strategy *strategy;
+  Picture *picture;
+  SearchBranch branch;
+  uint64_t limit, count;
+  bit *second;
+  struct PortfolioJob *jobs; // all of them
+  unsigned int index, njobs;
+  atomic_int *winner; // index of the first job to finish, or -1
+} PortfolioJob;
 
 Picture *mainpicture;
 unsigned int *leftborder, *topborder;
-uint64_t *gtestfield;
+Workspace *workspaces;
+unsigned int split_depth;
+uint64_t random_seed;
 unsigned int xsize, ysize, xysize, xpysize, vsize;
 unsigned int lmax, tmax;
+bool transposed; // the puzzle is being solved with its rows and columns swapped
+
+static inline Workspace *get_workspace(void)
+{
+  return workspaces + get_worker_id();
+}
+
+static Queue *acquire_queue(Workspace *ws)
+// While waiting for its line solving tasks, a worker may steal a task that
+// shakes another picture, so every level of nesting needs its own queue.
+{
+  if (ws->queue_depth == ws->nqueues)
+  {
+    ws->queues = resize(ws->queues, (ws->nqueues + 1) * sizeof(Queue*));
+    ws->queues[ws->nqueues++] = alloc_queue();
+  }
+  return ws->queues[ws->queue_depth++];
+}
+
+static inline void release_queue(Workspace *ws)
+{
+  ws->queue_depth--;
+}
 
-uint64_t fingercounter;
+static inline unsigned int evil_weight(const Picture *mpicture)
+{
+  return mpicture->trail != NULL ? mpicture->trail->strategy->evil_weight : 1;
+}
 
 static double binomln(int n, int k)
 // Return
@@ -70,15 +245,18 @@ static double binomln(int n, int k)
   return tmp;
 }
 
-static void raise_input_error(unsigned int n)
+static bool report_input_error(unsigned int n)
 {
   fprintf(stderr, "Invalid input at line %u!\n", n);
-  exit(EXIT_FAILURE);
+  return false;
 }
 
 static void handle_sigint()
 {
   const char *reset_colors = term_strings.dark;
+  // Let the solver stop and print what it has got so far.
+  if (interrupt_budget())
+    return;
   if (reset_colors == NULL)
     reset_colors = "";
   fflush(stdout);
@@ -119,7 +297,7 @@ static void print_picture_plain(bit *picture, bit *cpicture, bool use_ncurses)
     for (j = 0; j < xsize; j++)
     {
       str_color = term_strings.light[j & 1];
-      t = topborder[j * ysize + i];
+      t = topborder[top_offset(j) + i];
       printf("%s", str_color);
       if (t != 0 || i == 0)
         printf("%2u", t);
@@ -142,7 +320,7 @@ static void print_picture_plain(bit *picture, bit *cpicture, bool use_ncurses)
     for (j = 0; j < lmax; j++)
     {
       str_color = term_strings.light[j & 1];
-      t = leftborder[i * xsize + j];
+      t = leftborder[left_offset(i) + j];
       printf("%s", str_color);
       if (t != 0 || j == 0)
         printf("%2u", t);
@@ -190,6 +368,86 @@ static void print_picture_plain(bit *picture, bit *cpicture, bool use_ncurses)
   fflush(stdout);
 }
 
+static inline const char *paint_color(unsigned int color)
+// Return the terminal background nearest to the color.
+{
+  unsigned int rgb = colors[color].rgb;
+  return term_strings.paint[((rgb >> 23) & 1) | ((rgb >> 14) & 2) | ((rgb >> 5) & 4)];
+}
+
+static void print_color_picture_plain(const domain *cells)
+// Like print_picture_plain(), but every column is three chars wide,
+// so that a clue fits along with the name of its color.
+{
+  unsigned int i, j, t, c;
+
+  setup_termstrings(true, config.utf8, config.color);
+
+  printf("%s", term_strings.init);
+
+  for (i = 0; i < tmax; i++)
+  {
+    printf(" ");
+    for (j = 0; j < lmax; j++)
+      printf("   ");
+    for (j = 0; j < xsize; j++)
+    {
+      t = topborder[top_offset(j) + i];
+      if (t != 0)
+      {
+        c = topcolors[top_offset(j) + i];
+        printf("%s%2u%c%s", paint_color(c), t, colors[c].name, term_strings.dark);
+      }
+      else
+        printf("   ");
+    }
+    printf("\n");
+  }
+
+  for (i = 0; i < lmax; i++)
+    printf("%s", "   ");
+  printf("%s", term_strings.tl);
+  for (i = 0; i < xsize; i++)
+    printf("%s%s", term_strings.h, term_strings.h1);
+  printf("%s", term_strings.tr);
+  printf("%s", "\n");
+  for (i = 0; i < ysize; i++)
+  {
+    for (j = 0; j < lmax; j++)
+    {
+      t = leftborder[left_offset(i) + j];
+      if (t != 0)
+      {
+        c = leftcolors[left_offset(i) + j];
+        printf("%s%2u%c%s", paint_color(c), t, colors[c].name, term_strings.dark);
+      }
+      else
+        printf("%s", "   ");
+    }
+    printf("%s", term_strings.v);
+    for (j = 0; j < xsize; j++, cells++)
+    {
+      if (!is_color_known(*cells))
+        printf("<?>");
+      else if (*cells == BACKGROUND)
+        printf("   ");
+      else
+      {
+        c = first_color(*cells);
+        printf("%s%c%c%c%s", paint_color(c), colors[c].name, colors[c].name, colors[c].name, term_strings.dark);
+      }
+    }
+    printf("%s\n", term_strings.v);
+  }
+  for (i = 0; i < lmax; i++)
+    printf("%s", "   ");
+  printf("%s", term_strings.bl);
+  for (i = 0; i < xsize; i++)
+    printf("%s%s", term_strings.h, term_strings.h1);
+  printf("%s\n\n", term_strings.br);
+  fflush(stdout);
+}
+
 static void print_html_dtd(bool use_xhtml, bool need_charset)
 {
   if (use_xhtml && need_charset)
@@ -199,7 +457,26 @@ static void print_html_dtd(bool use_xhtml, bool need_charset)
     "<!DOCTYPE html PUBLIC '-//W3C//DTD HTML 4.01//EN' 'http://www.w3.org/TR/html4/strict.dtd'>\n");
 }
 
-static void print_picture_html(bit *picture, bool use_xhtml)
+static void print_html_clue(const unsigned int *border, const unsigned char *blockcolors, unsigned int n)
+{
+  if (blockcolors != NULL)
+    printf("<th style='color: #%06x'>%u</th>", colors[blockcolors[n]].rgb, border[n]);
+  else
+    printf("<th>%u</th>", border[n]);
+}
+
+static void print_html_color_cell(domain d)
+{
+  if (!is_color_known(d))
+    printf("<td class='v'>?</td>");
+  else if (d == BACKGROUND)
+    printf("<td>\xa0</td>");
+  else
+    printf("<td style='background-color: #%06x'>\xa0</td>", colors[first_color(d)].rgb);
+}
+
+static void print_picture_html(bit *picture, const domain *cells, bool use_xhtml)
+// Print either the picture or, for a colored puzzle, the cells.
 {
   unsigned int i, j;
   print_html_dtd(use_xhtml, true);
@@ -223,12 +500,14 @@ static void print_picture_html(bit *picture, bool use_xhtml)
     "<body>\n"
     "<table border='0' cellpadding='0' cellspacing='0'>");
 
-  unsigned int *top_desc_size = alloc(xsize * sizeof (unsigned int));
+  Arena *arena = get_workspace()->arena;
+  ArenaMark mark = arena_mark(arena);
+  unsigned int *top_desc_size = arena_alloc(arena, xsize * sizeof (unsigned int));
   for (i = 0; i < xsize; i++)
   {
     top_desc_size[i] = 0;
     for (j = 0; j < tmax; j++)
-      if (topborder[i * ysize + j] == 0)
+      if (topborder[top_offset(i) + j] == 0)
         break;
       else
         top_desc_size[i]++;
@@ -244,53 +523,109 @@ static void print_picture_html(bit *picture, bool use_xhtml)
       if (i < tmax - top_desc_size[j])
         printf("<th>\xa0</th>");
       else
-        printf("<th>%u</th>", topborder[j * ysize + i - tmax + top_desc_size[j]]);
+        print_html_clue(topborder, topcolors, top_offset(j) + i - tmax + top_desc_size[j]);
     }
     printf("</tr>\n");
   }
 
-  free(top_desc_size);
+  arena_release(arena, mark);
 
   for (i = 0; i < ysize; i++)
   {
     printf("<tr>");
     for (j = 0; j < lmax; j++)
-      if (leftborder[i * xsize + j] == 0)
+      if (leftborder[left_offset(i) + j] == 0)
         break;
     for (; j < lmax; j++)
       printf("<th>\xa0</th>");
     for (j = 0; j < lmax; j++)
-    {
-      unsigned int t = leftborder[i * xsize + j];
-      if (t != 0)
-        printf("<th>%u</th>", t);
-    }
-    for (j = 0; j < xsize; j++, picture++)
-    switch (*picture)
-    {
-    case Q:
-      printf("<td class='v'>?</td>");
-      break;
-    case O:
-      printf("<td>\xa0</td>");
-      break;
-    case X:
-      printf("<td class='x'>#</td>");
-      break;
-    }
+      if (leftborder[left_offset(i) + j] != 0)
+        print_html_clue(leftborder, leftcolors, left_offset(i) + j);
+    if (cells != NULL)
+      for (j = 0; j < xsize; j++, cells++)
+        print_html_color_cell(*cells);
+    else
+      for (j = 0; j < xsize; j++, picture++)
+      switch (*picture)
+      {
+      case Q:
+        printf("<td class='v'>?</td>");
+        break;
+      case O:
+        printf("<td>\xa0</td>");
+        break;
+      case X:
+        printf("<td class='x'>#</td>");
+        break;
+      }
     printf("</tr>\n");
   }
   printf("</table>\n</body>\n</html>\n");
 }
 
-static inline void print_picture(bit *picture, bit *cpicture)
+static void swap_axes(void)
+// Swap the rows and the columns of the clues; pictures are left alone.
+{
+  unsigned int *border, n;
+
+  border = leftborder, leftborder = topborder, topborder = border;
+  n = xsize, xsize = ysize, ysize = n;
+  n = lmax, lmax = tmax, tmax = n;
+}
+
+static bit *transpose_bits(const bit *bits)
+// Return a copy of the bits with the rows and the columns swapped.
+{
+  unsigned int i, j;
+  bit *result = alloc(vsize * sizeof(bit));
+
+  for (i = 0; i < ysize; i++)
+    for (j = 0; j < xsize; j++)
+      result[j * ysize + i] = bits[i * xsize + j];
+  return result;
+}
+
+static inline unsigned int grid_cell(unsigned int i, unsigned int j)
+// Return the index of the cell in the ith row and the jth column,
+// as the puzzle was given.
+{
+  return transposed ? j * xsize + i : i * xsize + j;
+}
+
+void print_picture(bit *picture, bit *cpicture)
+// Print the picture the way round the puzzle was given.
 {
+  bit *tpicture = NULL, *tcpicture = NULL;
+
   if (config.stats)
     return; // XXX undocumented!
+  if (transposed)
+  {
+    picture = tpicture = transpose_bits(picture);
+    if (cpicture != NULL)
+      cpicture = tcpicture = transpose_bits(cpicture);
+    swap_axes();
+  }
   if (config.html)
-    print_picture_html(picture, config.xhtml);
+    print_picture_html(picture, NULL, config.xhtml);
   else
     print_picture_plain(picture, cpicture, true);
+  if (transposed)
+  {
+    swap_axes();
+    free(tpicture);
+    free(tcpicture);
+  }
+}
+
+static inline void print_color_picture(const domain *cells)
+{
+  if (config.stats)
+    return;
+  if (config.html)
+    print_picture_html(NULL, cells, config.xhtml);
+  else
+    print_color_picture_plain(cells);
 }
 
 static uint64_t touch_line(bit *picture, unsigned int range, uint64_t *testfield, unsigned int *borderitem, bool vert)
@@ -299,7 +634,7 @@ static uint64_t touch_line(bit *picture, unsigned int range, uint64_t *testfield
   uint64_t z, ink;
   bool ok;
 
-  fingercounter++;
+  count_stat(STAT_LINE_SOLVES);
 
   sum = count = 0;
   mul = vert ? xsize : 1;
@@ -374,202 +709,715 @@ static uint64_t touch_line(bit *picture, unsigned int range, uint64_t *testfield
   return z;
 }
 
-static void finger_line(Picture *mpicture, Queue *queue)
+#define FIT 1 // the blocks fit into the cells
+#define GAP 2 // ... and the cell next to them may be empty
+
+static bool settle_span(bit *picture, unsigned int range, unsigned int mul, uint64_t *testfield, const unsigned int *blocks, unsigned int k)
+// Find out by dynamic programming which cells of the span some placement of
+// the k blocks fills and which ones some placement leaves empty.
+// Set the testfield as described in settle_line().
+// The first j blocks can't fit into fewer than lo[j] cells, and leave
+// slack cells for the rest to move in, so the tables keep only a band of
+// slack + 3 cells for every block: the work is proportional to the blocks
+// times the slack, rather than times the cells.
+// Return false if no placement fits.
 {
-  bit *picture;
-  uint64_t *testfield;
-  uint64_t q, u;
-  unsigned int i, j, imul, mul, size, oline, line;
-  int factor;
-  bool vert;
-
-  fingercounter++;
-  // lock this
-  line = oline = get_from_queue(queue);
-  if (line < ysize)
-    imul = xsize, mul = 1, size = xsize, vert = false;
-  else
-    imul = 1, mul = xsize, size = ysize, line -= ysize, vert = true;
-
-  j = mpicture->linecounter[oline];
-  if (j == 0 || j == size)
-    return;
-
-  picture = mpicture->bits + line * imul;
-  testfield = gtestfield;
-  memset(testfield, 0, size * sizeof(uint64_t));
+  Workspace *ws = get_workspace();
+  ArenaMark mark = arena_mark(ws->arena);
+  unsigned int i, j, len, first, last, slack, w;
+  unsigned int *lo, *run;
+  unsigned char *prefix, *suffix, *empty, v;
+  int *cover, acc;
+  bool gap;
+
+  lo = arena_alloc(ws->arena, (k + 1) * sizeof(unsigned int));
+  lo[0] = 0;
+  for (j = 1; j <= k; j++)
+    lo[j] = lo[j - 1] + blocks[j - 1] + (j > 1);
+  if (lo[k] > range)
+  {
+    arena_release(ws->arena, mark);
+    return false;
+  }
+  slack = range - lo[k];
+  w = slack + 3;
+  prefix = arena_alloc(ws->arena, (size_t) (k + 1) * w);
+  suffix = arena_alloc(ws->arena, (size_t) (k + 1) * w);
+  run = arena_alloc(ws->arena, (range + 1) * sizeof(unsigned int));
+  cover = arena_alloc(ws->arena, (range + 1) * sizeof(int));
+  empty = arena_alloc(ws->arena, range);
+  // The ith cell is in the band of the jth block if lo[j] - 1 <= i <= lo[j] + slack + 1.
+#define AT(table, j, i) (table)[(size_t) (j) * w + (i) + 1 - lo[j]]
+#define GET(table, j, i) ((i) + 1 >= lo[j] && (i) + 1 - lo[j] < w ? AT(table, j, i) : 0)
+#define FIRST(j) (lo[j] > 0 ? lo[j] - 1 : 0)
+#define LAST(j) (lo[j] + slack + 1 < range ? lo[j] + slack + 1 : range)
+
+  // How many cells from the ith on may be filled?
+  run[range] = 0;
+  for (i = range; i-- > 0; )
+    run[i] = picture[i * mul] == O ? 0 : run[i + 1] + 1;
+
+  // Do the first j blocks fit into the first i cells?
+  for (j = 0; j <= k; j++)
+  {
+    len = j > 0 ? blocks[j - 1] : 0;
+    for (i = FIRST(j), last = LAST(j); i <= last; i++)
+    {
+      gap = i == 0 ? j == 0 : (GET(prefix, j, i - 1) & FIT) && picture[(i - 1) * mul] != X;
+      v = gap ? FIT | GAP : 0;
+      if (j > 0 && i >= len && run[i - len] >= len && (GET(prefix, j - 1, i - len) & GAP))
+        v |= FIT;
+      AT(prefix, j, i) = v;
+    }
+  }
+  if (!(AT(prefix, k, range) & FIT))
+  {
+    arena_release(ws->arena, mark);
+    return false;
+  }
 
-  if (vert)
-    q = touch_line(picture, size, testfield, topborder + line * size, true); // lock?
-  else
-    q = touch_line(picture, size, testfield, leftborder + line * size, false);
+  // Do the blocks from the jth on fit into the cells from the ith on?
+  for (j = k + 1; j-- > 0; )
+  {
+    len = j < k ? blocks[j] : 0;
+    for (first = FIRST(j), i = LAST(j) + 1; i-- > first; )
+    {
+      gap = i == range ? j == k : (GET(suffix, j, i + 1) & FIT) && picture[i * mul] != X;
+      v = gap ? FIT | GAP : 0;
+      if (j < k && i + len <= range && run[i] >= len && (GET(suffix, j + 1, i + len) & GAP))
+        v |= FIT;
+      AT(suffix, j, i) = v;
+    }
+  }
 
-  j = vert ? 0 : ysize;
-  for (i = j; i < j + size; i++)
+  // Mark the cells that some placement leaves empty, and count how many
+  // placements of blocks cover every cell.
+  memset(empty, 0, range);
+  memset(cover, 0, (range + 1) * sizeof(int));
+  for (j = 0; j <= k; j++)
   {
-    u = *testfield++;
-    if ((u == q || u == 0) && (*picture == Q))
+    len = j < k ? blocks[j] : 0;
+    for (i = FIRST(j), last = LAST(j); i <= last; i++)
     {
-      mpicture->counter--;
-      mpicture->linecounter[oline]--;
-      factor = MAX_FACTOR * (--mpicture->linecounter[i]) / size + mpicture->evilcounter[i];
-      // lock queue here
-      put_into_queue(queue, i, factor);
-      *picture = u ? X : O;
+      if (i > 0 && (AT(prefix, j, i) & GAP) && (AT(suffix, j, i) & FIT))
+        empty[i - 1] = true;
+      if (j < k && i + len <= range && run[i] >= len && (AT(prefix, j, i) & GAP) && (GET(suffix, j + 1, i + len) & GAP))
+      {
+        cover[i]++;
+        cover[i + len]--;
+      }
     }
-    picture += mul;
   }
-}
+  for (i = 0, acc = 0; i < range; i++)
+  {
+    acc += cover[i];
+    testfield[i] = acc > 0 ? (empty[i] ? 1 : 2) : 0;
+  }
+#undef AT
+#undef GET
+#undef FIRST
+#undef LAST
 
-static void finger_lines(Picture *mpicture, Queue *queue) {
-  while (!is_queue_empty(queue))
-    finger_line(mpicture, queue);
+  arena_release(ws->arena, mark);
+  return true;
 }
 
-static bool check_consistency(bit *picture)
+#undef FIT
+#undef GAP
+
+static uint64_t settle_line(bit *picture, unsigned int range, uint64_t *testfield, const unsigned int *borderitem, bool vert)
+// Like touch_line(), but instead of counting the placements, which takes
+// time in proportion to their number (and would overflow on long lines),
+// find out which cells some placement fills and which ones some placement
+// leaves empty, in time proportional to the blocks times the room they have
+// to move in (see settle_span()). The testfield is 0 for cells that are always
+// empty, 2 for cells that are always filled, and 1 for the rest.
+// The known cells at either end are matched against the clues first, so
+// that only the unknown middle of the line takes time.
+// Return 2, or 0 if no placement fits.
 {
-  bool fr;
-  unsigned int i, j;
-  unsigned int r, rv;
-  unsigned int *border;
-  bit *tpicture;
+  unsigned int i, k, m, len, mul, start, end;
 
-  for (i = 0; i < ysize; i++)
+  count_stat(STAT_LINE_SOLVES);
+
+  mul = vert ? xsize : 1;
+  for (k = 0; k < range && borderitem[k] > 0; k++)
+    ;
+  for (i = 0; i < range; i++)
+    testfield[i] = picture[i * mul] == X ? 2 : 0;
+
+  // The blocks before the first unknown cell must be the first clues.
+  m = len = start = 0;
+  for (i = 0; i < range && picture[i * mul] != Q; i++)
   {
-    fr = true;
-    r = 0;
-    rv = 0;
-    border = leftborder + i * xsize;
-    tpicture = picture + i * xsize;
-    for (j = 0; j < xsize && fr; j++, tpicture++)
-    switch (*tpicture)
-    {
-    case Q:
-      fr = false;
-      break;
-    case X:
-      rv++;
-      break;
-    case O:
-      if (rv == 0)
-        break;
-      if (*border != rv)
-      {
-        if (ENABLE_DEBUG)
-          fprintf(stderr, "Inconsistency at row #%u[%u]! (%u, expected %u)!\n", i, j, rv, *border);
-        return false;
-      }
-      rv = 0; r++; border++;
-      break;
-    default:
-      ;
-    }
-    if (fr && *border != rv)
+    if (picture[i * mul] == X)
+      len++;
+    else
     {
-      if (ENABLE_DEBUG)
-        fprintf(stderr, "Inconsistency at the end of row #%u! (%u, expected %u)\n", i, rv, *border);
-      return false;
+      if (len > 0 && (m == k || borderitem[m++] != len))
+        return 0;
+      len = 0;
+      start = i + 1;
     }
   }
+  if (i == range)
+  {
+    // All the cells are known.
+    if (len > 0 && (m == k || borderitem[m++] != len))
+      return 0;
+    return m == k ? 2 : 0;
+  }
 
-  for (i = 0; i < xsize; i++)
+  // Likewise, the blocks after the last unknown cell must be the last clues.
+  len = 0;
+  end = range;
+  for (i = range; picture[(i - 1) * mul] != Q; i--)
   {
-    fr = true;
-    r = 0;
-    rv = 0;
-    border = topborder + i * ysize;
-    tpicture = picture + i;
-    for (j = 0; j < ysize && fr; j++, tpicture += xsize)
-    switch (*tpicture)
-    {
-    case Q:
-      fr = false;
-      break;
-    case X:
-      rv++;
-      break;
-    case O:
-      if (rv == 0)
-        break;
-      if (*border != rv)
-      {
-        if (ENABLE_DEBUG)
-          fprintf(stderr, "Inconsistency at column #%u[%u]! (%u, expected %u)\n", i, j, rv, *border);
-        return false;
-      }
-      rv = 0; r++; border++;
-      break;
-    default:
-      ;
-    }
-    if (fr && *border != rv)
+    if (picture[(i - 1) * mul] == X)
+      len++;
+    else
     {
-      if (ENABLE_DEBUG)
-        fprintf(stderr, "Inconsistency at the end of column #%u! (%u, expected %u)\n", i, rv, *border);
-      return false;
+      if (len > 0 && (k == m || borderitem[--k] != len))
+        return 0;
+      len = 0;
+      end = i - 1;
     }
   }
-  return true;
+
+  return settle_span(picture + start * mul, end - start, mul, testfield + start, borderitem + m, k - m) ? 2 : 0;
 }
 
-static inline void *alloc_border(void)
+static double count_placements_ln(unsigned int line)
+// Return ln of the number of ways to place the blocks of the line,
+// regardless of its known cells.
 {
-  return alloc(vsize * sizeof(unsigned int));
+  unsigned int j, size, sum, *border;
+
+  if (line < ysize)
+    border = leftborder + left_offset(line), size = xsize;
+  else
+    border = topborder + top_offset(line - ysize), size = ysize;
+  sum = 0;
+  for (j = 0; j < size && border[j] > 0; j++)
+    sum += border[j];
+  return binomln(size - sum + 1, j);
 }
 
-static inline void *alloc_testfield(void)
+static inline bool is_crowded_line(unsigned int line)
+// Tell whether the blocks of the line may be placed in too many ways
+// for touch_line() to go through all of them.
 {
-  return alloc(xysize * sizeof(uint64_t));
+  return count_placements_ln(line) + log(line < ysize ? xsize : ysize) > log(TOUCH_MAX_WORK);
 }
 
-static void *alloc_picture(void)
+uint64_t solve_line(bit *bits, unsigned int line, uint64_t *testfield)
+// For each cell of the line, count the block placements that cover it.
+// Return the total number of placements.
+// Crowded lines are settled instead (see settle_line()).
+{
+  bool crowded = is_crowded_line(line);
+
+  if (line < ysize)
+  {
+    if (crowded)
+      return settle_line(bits + line * xsize, xsize, testfield, leftborder + left_offset(line), false);
+    memset(testfield, 0, xsize * sizeof(uint64_t));
+    return touch_line(bits + line * xsize, xsize, testfield, leftborder + left_offset(line), false);
+  }
+  line -= ysize;
+  if (crowded)
+    return settle_line(bits + line, ysize, testfield, topborder + top_offset(line), true);
+  memset(testfield, 0, ysize * sizeof(uint64_t));
+  return touch_line(bits + line, ysize, testfield, topborder + top_offset(line), true);
+}
+
+static inline void note_cell(Trail *trail, unsigned int n, int reason, const uint64_t *nogood)
+// Record why the n-th cell has just been set.
+{
+  CellReason *cell;
+  assert(trail->region->cell_index[n] != NO_CELL);
+  cell = trail->cells + trail->region->cell_index[n];
+  cell->stamp = trail->clock++;
+  cell->nogood = nogood;
+  cell->level = trail->level;
+  cell->reason = reason;
+}
+
+static inline unsigned int yield_class(unsigned int size)
+{
+  unsigned int c = 0;
+  while (size > 1 && c < YIELD_CLASSES - 1)
+    size >>= 1, c++;
+  return c;
+}
+
+static inline unsigned int line_size(unsigned int line)
+{
+  return line < ysize ? xsize : ysize;
+}
+
+static void reset_yields(Workspace *ws)
+// Forget what has been learned about the lines of the previous puzzle.
 {
   unsigned int i;
-  Picture *tmp =
-    alloc(
-      offsetof(Picture, bits) +
-      vsize * sizeof(bit) );
-  tmp->linecounter = alloc(sizeof(unsigned int) * xpysize);
-  tmp->evilcounter = alloc(sizeof(unsigned int) * xpysize);
-  for (i = 0; i < ysize; i++)
-    tmp->linecounter[i] = xsize;
-  for (i = 0; i < xsize; i++)
-    tmp->linecounter[ysize + i] = ysize;
-  tmp->counter = vsize;
-  return tmp;
+  for (i = 0; i < xpysize; i++)
+  {
+    ws->yields[i].rate = -1.0;
+    ws->yields[i].unknown = line_size(i);
+  }
+  for (i = 0; i < YIELD_CLASSES; i++)
+    ws->class_rates[i] = 1.0;
 }
 
-static inline void free_picture(Picture *picture)
+static int yield_priority(Picture *mpicture, unsigned int line)
+// Lines that are expected to fix the most cells per unit of work go first.
+// The work is the number of block placements, known from the last solve of
+// the line (see learn_yield()); the cells fixed are the cells fixed by the
+// crossing lines since then, times the rate learned for this line and for
+// the lines of its length.
 {
-  free(picture->linecounter);
-  free(picture->evilcounter);
-  free(picture);
+  Workspace *ws = get_workspace();
+  LineYield *yield = ws->yields + line;
+  unsigned int unknown = mpicture->linecounter[line];
+  double rate, news, work;
+
+  rate = ws->class_rates[yield_class(unknown)];
+  if (yield->rate >= 0.0)
+    rate = (rate + yield->rate) / 2;
+  news = yield->unknown > unknown ? yield->unknown - unknown : 1;
+  work = (double) mpicture->evilcounter[line] / (MAX_EVIL * MAX_FACTOR);
+  return MAX_FACTOR * (work - log(news * rate + 1e-3));
 }
 
-static inline void duplicate_picture(Picture *src, Picture *dst)
+static void learn_yield(Picture *mpicture, unsigned int line, unsigned int unknown, uint64_t q, unsigned int fixed)
+// Record what solving the line, with the given number of unknown cells
+// and of placements, has fixed.
 {
-  dst->counter = src->counter;
-  memcpy(dst->linecounter, src->linecounter, sizeof(unsigned int) * xpysize);
-  memcpy(dst->evilcounter, src->evilcounter, sizeof(unsigned int) * xpysize);
-  memcpy(dst->bits, src->bits, vsize * sizeof(bit));
+  Workspace *ws = get_workspace();
+  LineYield *yield = ws->yields + line;
+  float *class_rate = ws->class_rates + yield_class(unknown);
+  double rate, news, evil;
+
+  news = yield->unknown > unknown ? yield->unknown - unknown : 1;
+  rate = fixed / news;
+  yield->rate = yield->rate < 0.0 ? rate : (1 - YIELD_DECAY) * yield->rate + YIELD_DECAY * rate;
+  *class_rate = (1 - YIELD_DECAY) * *class_rate + YIELD_DECAY * rate;
+  yield->unknown = unknown - fixed;
+  // The line has narrowed: its evilness is what it has got left.
+  evil = q > 1 ? log(q) : 0.0;
+  if (evil > MAX_EVIL)
+    evil = MAX_EVIL;
+  mpicture->evilcounter[line] = evil * MAX_EVIL * MAX_FACTOR;
 }
 
-static void preliminary_shake(Picture *mpicture)
+unsigned int apply_line(Picture *mpicture, Queue *queue, unsigned int oline, uint64_t *testfield, uint64_t q)
+// Fix the cells that are covered by either all or none of the placements,
+// and enqueue the crossing lines.
+// Return the number of cells fixed.
 {
-  unsigned int i, j, k;
-  unsigned int R, ML;
   bit *picture;
-  unsigned int *band;
+  uint64_t u;
+  unsigned int i, j, n, imul, mul, size, line, fixed, unknown;
+  int factor;
+  bool vert;
 
-  for (i = 0; i < ysize; i++)
+  if (q == 0 && mpicture->trail != NULL)
   {
-    band = leftborder + i * xsize;
+    // No placement fits: the picture has no solution.
+    mpicture->trail->conflict = oline;
+    return 0;
+  }
+
+  line = oline;
+  if (line < ysize)
+    imul = xsize, mul = 1, size = xsize, vert = false;
+  else
+    imul = 1, mul = xsize, size = ysize, line -= ysize, vert = true;
+
+  picture = mpicture->bits + line * imul;
+  fixed = 0;
+  unknown = mpicture->linecounter[oline];
+
+  j = vert ? 0 : ysize;
+  for (i = j; i < j + size; i++)
+  {
+    u = *testfield++;
+    if ((u == q || u == 0) && (*picture == Q))
+    {
+      fixed++;
+      mpicture->counter--;
+      mpicture->linecounter[oline]--;
+      --mpicture->linecounter[i];
+      if (config.yield_scheduling)
+        factor = yield_priority(mpicture, i);
+      else
+        factor = MAX_FACTOR * mpicture->linecounter[i] / size + evil_weight(mpicture) * mpicture->evilcounter[i];
+      put_into_queue(queue, i, factor);
+      *picture = u ? X : O;
+      n = picture - mpicture->bits;
+      mpicture->hash ^= zobrist_key(n, *picture);
+      if (mpicture->trail != NULL)
+        note_cell(mpicture->trail, n, oline, NULL);
+    }
+    picture += mul;
+  }
+  if (config.yield_scheduling)
+    learn_yield(mpicture, oline, unknown, q, fixed);
+  return fixed;
+}
+
+static inline bool is_line_done(Picture *mpicture, unsigned int line)
+{
+  unsigned int j = mpicture->linecounter[line];
+  return j == 0 || j == (line < ysize ? xsize : ysize);
+}
+
+static void finger_line(Workspace *ws, Queue *queue, Picture *mpicture)
+{
+  unsigned int line, fixed;
+
+  count_stat(STAT_LINE_SOLVES);
+  line = get_from_queue(queue);
+  if (is_line_done(mpicture, line))
+    return;
+  fixed = apply_line(mpicture, queue, line, ws->testfield, solve_line(mpicture->bits, line, ws->testfield));
+  TRACE(TRACE_LINE_SOLVE, line, fixed);
+}
+
+static void line_task(void *arg)
+{
+  LineJob *job = arg;
+  job->count = solve_line(job->bits, job->line, job->testfield);
+}
+
+static void finger_lines(Workspace *ws, Queue *queue, Picture *mpicture)
+{
+  unsigned int i, n, batch, line, fixed;
+  bool vert;
+  LineJob *jobs;
+  Task *tasks;
+  uint64_t *testfields;
+  TaskGroup group;
+  ArenaMark mark;
+
+  if (get_worker_count() == 1)
+  {
+    while (!is_queue_empty(queue) && !has_conflict(mpicture) && !check_budget())
+      finger_line(ws, queue, mpicture);
+    return;
+  }
+
+  // Lines of the same direction don't share any cells,
+  // so a batch of them can be solved in parallel.
+  // The results are then applied serially, in the queue order.
+  batch = LINE_BATCH_FACTOR * get_worker_count();
+  mark = arena_mark(ws->arena);
+  jobs = arena_alloc(ws->arena, batch * sizeof(LineJob));
+  tasks = arena_alloc(ws->arena, batch * sizeof(Task));
+  testfields = arena_alloc(ws->arena, batch * xysize * sizeof(uint64_t));
+  while (!is_queue_empty(queue) && !has_conflict(mpicture) && !check_budget())
+  {
+    vert = peek_queue(queue) >= ysize;
+    n = 0;
+    while (n < batch && !is_queue_empty(queue) && (peek_queue(queue) >= ysize) == vert)
+    {
+      count_stat(STAT_LINE_SOLVES);
+      line = get_from_queue(queue);
+      if (is_line_done(mpicture, line))
+        continue;
+      jobs[n].bits = mpicture->bits;
+      jobs[n].line = line;
+      jobs[n].testfield = testfields + n * xysize;
+      n++;
+    }
+    if (n == 0)
+      continue;
+    init_task_group(&group);
+    for (i = 1; i < n; i++)
+      spawn_task(&group, tasks + i, line_task, jobs + i);
+    line_task(jobs);
+    sync_tasks(&group);
+    for (i = 0; i < n && !has_conflict(mpicture); i++)
+    {
+      fixed = apply_line(mpicture, queue, jobs[i].line, jobs[i].testfield, jobs[i].count);
+      TRACE(TRACE_LINE_SOLVE, jobs[i].line, fixed);
+    }
+  }
+  arena_release(ws->arena, mark);
+}
+
+static bool check_line(bit *picture, unsigned int line)
+{
+  bool fr = true;
+  unsigned int j, rv, size, mul;
+  unsigned int *border;
+  const char *kind;
+
+  if (line < ysize)
+  {
+    kind = "row";
+    border = leftborder + left_offset(line);
+    picture += line * xsize;
+    size = xsize, mul = 1;
+  }
+  else
+  {
+    kind = "column";
+    line -= ysize;
+    border = topborder + top_offset(line);
+    picture += line;
+    size = ysize, mul = xsize;
+  }
+  rv = 0;
+  for (j = 0; j < size && fr; j++, picture += mul)
+  switch (*picture)
+  {
+  case Q:
+    fr = false;
+    break;
+  case X:
+    rv++;
+    break;
+  case O:
+    if (rv == 0)
+      break;
+    if (*border != rv)
+    {
+      if (ENABLE_DEBUG)
+        fprintf(stderr, "Inconsistency at %s #%u[%u]! (%u, expected %u)\n", kind, line, j, rv, *border);
+      return false;
+    }
+    rv = 0; border++;
+    break;
+  default:
+    ;
+  }
+  if (!fr)
+    return true;
+  if (rv > 0 && *border == rv)
+    rv = 0, border++;
+  // Every clue must have been used up, not only the current one.
+  if (*border != rv)
+  {
+    if (ENABLE_DEBUG)
+      fprintf(stderr, "Inconsistency at the end of %s #%u! (%u, expected %u)\n", kind, line, rv, *border);
+    return false;
+  }
+  return true;
+}
+
+bool check_consistency(bit *picture)
+{
+  unsigned int i;
+  for (i = 0; i < xpysize; i++)
+    if (!check_line(picture, i))
+      return false;
+  return true;
+}
+
+static int find_inconsistency(bit *picture, const Region *region)
+// Return a line of the region that contradicts its clues, or -1.
+{
+  unsigned int i;
+  for (i = 0; i < region->nlines; i++)
+    if (!check_line(picture, region->lines[i]))
+      return region->lines[i];
+  return -1;
+}
+
+static inline void *alloc_border(size_t size)
+{
+  return alloc(size * sizeof(unsigned int));
+}
+
+static void *restride(void *table, size_t width, unsigned int nlines, unsigned int from, unsigned int to)
+// Move the lines of a table from `from` entries apart to `to` entries apart.
+// Entries added at the end of a line are 0; the ones cut off are lost.
+{
+  unsigned char *lines = table;
+  size_t a = from * width, b = to * width;
+  unsigned int i;
+
+  if (to > from)
+  {
+    lines = resize(lines, nlines * b);
+    for (i = nlines; i-- > 0; )
+    {
+      memmove(lines + i * b, lines + i * a, a);
+      memset(lines + i * b + a, 0, b - a);
+    }
+    return lines;
+  }
+  for (i = 0; i < nlines; i++)
+    memmove(lines + i * b, lines + i * a, b);
+  return resize(lines, nlines * b);
+}
+
+static void restride_clues(bool rows, unsigned int max)
+// Give every list of clues of the rows (or of the columns) room for max
+// clues, and make that the new lmax (or tmax).
+{
+  if (rows && max != lmax)
+  {
+    leftborder = restride(leftborder, sizeof(unsigned int), ysize, lmax + 1, max + 1);
+    if (leftcolors != NULL)
+      leftcolors = restride(leftcolors, 1, ysize, lmax + 1, max + 1);
+    lmax = max;
+  }
+  else if (!rows && max != tmax)
+  {
+    topborder = restride(topborder, sizeof(unsigned int), xsize, tmax + 1, max + 1);
+    if (topcolors != NULL)
+      topcolors = restride(topcolors, 1, xsize, tmax + 1, max + 1);
+    tmax = max;
+  }
+}
+
+static inline void make_room(bool rows, unsigned int nclues)
+// While the clues are read, the lists grow by doubling; once they all have
+// been read, restride_clues() shrinks them to the longest one.
+{
+  unsigned int max = rows ? lmax : tmax;
+
+  if (nclues > max)
+    restride_clues(rows, nclues > 2 * max ? nclues : 2 * max);
+}
+
+static inline void *alloc_testfield(void)
+{
+  return alloc(xysize * sizeof(uint64_t));
+}
+
+static inline size_t picture_bits_size(void)
+// Size of the bits, padded so that the line counters that follow are aligned.
+{
+  return (vsize * sizeof(bit) + sizeof(unsigned int) - 1) / sizeof(unsigned int) * sizeof(unsigned int);
+}
+
+static inline size_t picture_size(void)
+{
+  return offsetof(Picture, bits) + picture_bits_size() + 2 * xpysize * sizeof(unsigned int);
+}
+
+static Picture *setup_picture(void *space)
+// Lay out a picture in a single chunk of memory:
+// the bits first, then the line counters.
+{
+  Picture *tmp = space;
+  tmp->linecounter = (unsigned int*)((char*)tmp->bits + picture_bits_size());
+  tmp->evilcounter = tmp->linecounter + xpysize;
+  return tmp;
+}
+
+static void alloc_workspaces(void)
+{
+  unsigned int i, n = get_worker_count();
+
+  workspaces = alloc(n * sizeof(Workspace));
+  for (i = 0; i < n; i++)
+  {
+    workspaces[i].arena = alloc_arena(16 * picture_size());
+    workspaces[i].queues = NULL;
+    workspaces[i].nqueues = workspaces[i].queue_depth = 0;
+    workspaces[i].testfield = alloc_testfield();
+    workspaces[i].seen = alloc(vsize * sizeof(unsigned int));
+    workspaces[i].stack = alloc(vsize * sizeof(unsigned int));
+    workspaces[i].yields = alloc(xpysize * sizeof(LineYield));
+  }
+  split_depth = 0;
+  if (n > 1)
+  {
+    // Give each worker a few subtrees to keep the load balanced.
+    for (split_depth = 3; n > 1; n >>= 1)
+      split_depth++;
+  }
+}
+
+static void free_workspaces(void)
+{
+  unsigned int i, j, n = get_worker_count();
+
+  for (i = 0; i < n; i++)
+  {
+    free_arena(workspaces[i].arena);
+    for (j = 0; j < workspaces[i].nqueues; j++)
+      free_queue(workspaces[i].queues[j]);
+    free(workspaces[i].queues);
+    free(workspaces[i].testfield);
+    free(workspaces[i].seen);
+    free(workspaces[i].stack);
+    free(workspaces[i].yields);
+  }
+  free(workspaces);
+  workspaces = NULL;
+}
+
+static void setup_workspaces(void)
+// The per-worker buffers and the transposition table outlive a puzzle, so
+// that the daemon can reuse them; the buffers are reallocated only when
+// a bigger puzzle comes.
+{
+  static unsigned int capacity[3];
+  unsigned int i;
+
+  if (workspaces == NULL || vsize > capacity[0] || xpysize > capacity[1] || xysize > capacity[2])
+  {
+    if (workspaces != NULL)
+      free_workspaces();
+    alloc_workspaces();
+    capacity[0] = vsize;
+    capacity[1] = xpysize;
+    capacity[2] = xysize;
+  }
+  clear_ttable();
+  for (i = 0; i < get_worker_count(); i++)
+    reset_yields(workspaces + i);
+}
+
+void *alloc_picture(void)
+{
+  unsigned int i;
+  Picture *tmp = setup_picture(alloc(picture_size()));
+  for (i = 0; i < ysize; i++)
+    tmp->linecounter[i] = xsize;
+  for (i = 0; i < xsize; i++)
+    tmp->linecounter[ysize + i] = ysize;
+  tmp->counter = vsize;
+  tmp->hash = 0;
+  tmp->trail = NULL;
+  return tmp;
+}
+
+static inline Picture *arena_picture(Arena *arena)
+// The contents are left uninitialized; fill them with duplicate_picture()
+// and set the trail.
+{
+  return setup_picture(arena_alloc(arena, picture_size()));
+}
+
+void duplicate_picture(Picture *src, Picture *dst)
+{
+  dst->counter = src->counter;
+  dst->hash = src->hash;
+  memcpy(dst->bits, src->bits, picture_size() - offsetof(Picture, bits));
+}
+
+static void preliminary_shake(Picture *mpicture)
+{
+  unsigned int i, j, k;
+  unsigned int R, ML;
+  bit *picture;
+  unsigned int *band;
+
+  for (i = 0; i < ysize; i++)
+  {
+    band = leftborder + left_offset(i);
     R = *band++;
     ML = R;
     while (*band > 0)
       ML += *band++ + 1;
 
-    band = leftborder + i * xsize;
+    band = leftborder + left_offset(i);
     if (*band == 0)
     {
       picture = &mpicture->bits[i * xsize];
@@ -598,13 +1446,13 @@ static void preliminary_shake(Picture *mpicture)
 
   for (i = 0; i < xsize; i++)
   {
-    band = topborder + i * ysize;
+    band = topborder + top_offset(i);
     R = *band++;
     ML = R;
     while (*band > 0)
       ML += *band++ + 1;
 
-    band = topborder + i * ysize;
+    band = topborder + top_offset(i);
     if (*band == 0)
     {
       picture = mpicture->bits + i;
@@ -640,74 +1488,995 @@ static void preliminary_shake(Picture *mpicture)
   {
     mpicture->linecounter[i]--;
     mpicture->linecounter[ysize + j]--;
+    mpicture->hash ^= zobrist_key(picture - mpicture->bits, *picture);
   }
 }
 
-static inline void shake(Picture *mpicture)
+static inline int initial_priority(Picture *mpicture, unsigned int line)
 {
-  unsigned int i, j;
-  int factor;
-  Queue *queue = alloc_queue();
+  if (config.yield_scheduling)
+    return yield_priority(mpicture, line);
+  if (line < ysize)
+    return MAX_FACTOR * mpicture->linecounter[line] / xsize + evil_weight(mpicture) * mpicture->evilcounter[line];
+  else
+    return MAX_FACTOR * mpicture->linecounter[line] / ysize + evil_weight(mpicture) * mpicture->evilcounter[line - ysize];
+}
+
+bool shake(Picture *mpicture, const Region *region)
+// Line-solve the picture, starting from all the lines of the region
+// (or of the whole grid, if region is NULL).
+// Return false if a line has no valid placement; this is detected only
+// for pictures with a trail.
+{
+  unsigned int i;
+  Workspace *ws = get_workspace();
+  Queue *queue = acquire_queue(ws);
 
   assert(ysize > 0);
+  count_stat(STAT_SHAKES);
+  reset_queue(queue);
+  if (mpicture->trail != NULL)
+    mpicture->trail->conflict = -1;
+
+  if (region == NULL)
+    for (i = 0; i < xpysize; i++)
+      put_into_queue(queue, i, initial_priority(mpicture, i));
+  else
+    for (i = 0; i < region->nlines; i++)
+      put_into_queue(queue, region->lines[i], initial_priority(mpicture, region->lines[i]));
+
+  TRACE(TRACE_SHAKE_BEGIN, mpicture->counter, 0);
+  finger_lines(ws, queue, mpicture);
+  release_queue(ws);
+  TRACE(TRACE_SHAKE_END, mpicture->counter, 0);
+  return !has_conflict(mpicture);
+}
+
+
+
+static inline void assign_cell(Picture *mpicture, unsigned int n, bit value)
+{
+  mpicture->bits[n] = value;
+  mpicture->hash ^= zobrist_key(n, value);
+  mpicture->counter--;
+  mpicture->linecounter[n / xsize]--;
+  mpicture->linecounter[ysize + n % xsize]--;
+}
+
+void put_cell(Picture *mpicture, unsigned int n, bit value)
+// Set an unknown cell of a picture.
+{
+  assign_cell(mpicture, n, value);
+}
 
-for (i = 0; i < ysize; i++)
+void set_cell(Picture *mpicture, unsigned int n, bit value, int reason)
+// Set an unknown cell of a picture with a trail, as if the line had set it.
+{
+  assign_cell(mpicture, n, value);
+  note_cell(mpicture->trail, n, reason, NULL);
+}
+
+static bool is_cancelled(SearchBranch *branch)
+{
+  if (is_out_of_budget())
+    return true;
+  for (; branch != NULL; branch = branch->parent)
+    if (atomic_load_explicit(&branch->cancelled, memory_order_relaxed))
+      return true;
+  return false;
+}
+
+static void charge_restart(Restart *restart)
+// Count a search node against the budget of the current run.
+// When it runs out, cancel the whole run.
+{
+  if (atomic_fetch_add_explicit(&restart->nodes, 1, memory_order_relaxed) + 1 >= restart->budget)
+    atomic_store(&restart->branch->cancelled, true);
+}
+
+static inline size_t levelset_size(unsigned int maxlevel)
+// Sets of decision levels are kept as bit sets.
+{
+  return (maxlevel / 64 + 1) * sizeof(uint64_t);
+}
+
+static inline void add_level(uint64_t *set, unsigned int level)
+{
+  set[level / 64] |= (uint64_t)1 << level % 64;
+}
+
+static inline void remove_level(uint64_t *set, unsigned int level)
+{
+  set[level / 64] &= ~((uint64_t)1 << level % 64);
+}
+
+static inline bool has_level(const uint64_t *set, unsigned int level)
+{
+  return set[level / 64] >> level % 64 & 1;
+}
+
+static void fill_levelset(uint64_t *set, unsigned int maxlevel)
+// Blame all the decisions.
+{
+  memset(set, 0xff, levelset_size(maxlevel));
+}
+
+static Trail *alloc_trail(Arena *arena, const Region *region, const Strategy *strategy)
+// The cell reasons are left uninitialized:
+// they are written when the cells are set.
+{
+  Trail *tmp = arena_alloc(arena, sizeof(Trail));
+  tmp->region = region;
+  tmp->strategy = strategy;
+  tmp->restart = NULL;
+  tmp->cells = arena_alloc(arena, region->ncells * sizeof(CellReason));
+  tmp->clock = 0;
+  tmp->level = 0;
+  tmp->conflict = -1;
+  return tmp;
+}
+
+void record_reasons(Picture *mpicture, const Region *region)
+// From now on, remember which line has set each cell of the region.
+{
+  Trail *tmp = alloc(sizeof(Trail));
+  tmp->region = region;
+  tmp->strategy = DEFAULT_STRATEGY;
+  tmp->restart = NULL;
+  tmp->cells = alloc(region->ncells * sizeof(CellReason));
+  tmp->clock = 0;
+  tmp->level = 0;
+  tmp->conflict = -1;
+  mpicture->trail = tmp;
+}
+
+void forget_reasons(Picture *mpicture)
+{
+  free(mpicture->trail->cells);
+  free(mpicture->trail);
+  mpicture->trail = NULL;
+}
+
+static Trail *copy_trail(Arena *arena, const Trail *trail)
+{
+  Trail *tmp = arena_alloc(arena, sizeof(Trail));
+  *tmp = *trail;
+  tmp->cells = arena_alloc(arena, trail->region->ncells * sizeof(CellReason));
+  memcpy(tmp->cells, trail->cells, trail->region->ncells * sizeof(CellReason));
+  return tmp;
+}
+
+static void push_reasons(Workspace *ws, Picture *mpicture, unsigned int line, uint64_t stamp, unsigned int *top)
+// Put onto the stack the known cells of the line that were set before the stamp
+// by the search (and that haven't been visited yet).
+{
+  Trail *trail = mpicture->trail;
+  CellReason *cell;
+  unsigned int i, n, mul, size, index;
+
+  if (line < ysize)
+    n = line * xsize, mul = 1, size = xsize;
+  else
+    n = line - ysize, mul = xsize, size = ysize;
+  for (i = 0; i < size; i++, n += mul)
   {
-    factor = MAX_FACTOR * mpicture->linecounter[i] / xsize + mpicture->evilcounter[i];
-    put_into_queue(queue, i, factor);
+    if (mpicture->bits[n] == Q)
+      continue;
+    index = trail->region->cell_index[n];
+    if (index == NO_CELL)
+      continue; // known before the search
+    cell = trail->cells + index;
+    if (cell->level == 0 || cell->stamp >= stamp || ws->seen[index] == ws->epoch)
+      continue;
+    ws->seen[index] = ws->epoch;
+    ws->stack[(*top)++] = index;
   }
+}
+
+static void analyze_conflict(Picture *mpicture, unsigned int line, uint64_t *conflict)
+// Walk back from a contradiction in the line to the decisions that caused it,
+// and add their levels to the conflict set.
+{
+  Workspace *ws = get_workspace();
+  Trail *trail = mpicture->trail;
+  CellReason *cell;
+  unsigned int i, top = 0;
 
-  for (i = 0, j = ysize; i < xsize; i++, j++)
+  if (++ws->epoch == 0)
   {
-    factor = MAX_FACTOR * mpicture->linecounter[j] / ysize + mpicture->evilcounter[i];
-    put_into_queue(queue, j, factor);
+    memset(ws->seen, 0, vsize * sizeof(unsigned int));
+    ws->epoch = 1;
+  }
+  push_reasons(ws, mpicture, line, UINT64_MAX, &top);
+  while (top > 0)
+  {
+    cell = trail->cells + ws->stack[--top];
+    switch (cell->reason)
+    {
+    case REASON_DECISION:
+      add_level(conflict, cell->level);
+      break;
+    case REASON_NOGOOD:
+      for (i = 0; i < levelset_size(cell->level) / sizeof(uint64_t); i++)
+        conflict[i] |= cell->nogood[i];
+      break;
+    default:
+      push_reasons(ws, mpicture, cell->reason, cell->stamp, &top);
+    }
   }
+}
 
-  double fingerstart = omp_get_wtime();
-  cilk_spawn finger_lines(mpicture, queue);
-  double fingerend = omp_get_wtime();
+static bool propagate(Picture *mpicture, const Region *region, uint64_t *conflict)
+// Shake the picture. If it turns out to have no solution,
+// add the levels of the decisions to blame to the conflict set.
+{
+  if (shake(mpicture, region))
+    return true;
+  analyze_conflict(mpicture, mpicture->trail->conflict, conflict);
+  return false;
+}
+
+static void save_region(const Region *region, Picture *mpicture, bit *cells)
+{
+  unsigned int i;
+  for (i = 0; i < region->ncells; i++)
+    cells[i] = mpicture->bits[region->cells[i]];
+}
 
-  printf("fingerings: %.02f seconds\n", fingerend-fingerstart);
-  free_queue(queue);
-  return;
+static inline bit first_value(const Trail *trail)
+{
+  return trail->restart != NULL ? trail->restart->first : trail->strategy->first;
 }
 
+static uint64_t backtrack(Picture*, const Region*, unsigned int, unsigned int, SearchBranch*, uint64_t*, uint64_t, bit*);
 
+static void search_task(void *arg)
+{
+  SearchJob *job = arg;
+  job->count = 0;
+  if (propagate(job->picture, job->region, job->conflict))
+    job->count = backtrack(job->picture, job->region, job->start, job->depth, &job->branch, job->conflict, job->limit, job->second);
+}
 
-static bool backtrack(Picture *mpicture)
+static uint64_t split_search(Picture *mpicture, const Region *region, unsigned int k, unsigned int depth, SearchBranch *branch, uint64_t *conflict, uint64_t limit, bit *second)
+// Explore both values of the k-th cell of the region in parallel.
+// The solutions are ordered as serial search would find them.
 {
-  Picture *mclone;
+  const bit first = first_value(mpicture->trail);
+  const bit values[2] = { first, -first };
+  Workspace *ws = get_workspace();
+  ArenaMark mark = arena_mark(ws->arena);
+  SearchJob jobs[2];
+  Task task;
+  TaskGroup group;
+  unsigned int i, j, n = region->cells[k];
+  uint64_t count;
+
+  count_stat(STAT_SPLITS);
+  TRACE(TRACE_DECISION, n, depth);
+  for (i = 0; i < 2; i++)
+  {
+    jobs[i].picture = arena_picture(ws->arena);
+    duplicate_picture(mpicture, jobs[i].picture);
+    jobs[i].picture->trail = copy_trail(ws->arena, mpicture->trail);
+    jobs[i].picture->trail->level = depth + 1;
+    assign_cell(jobs[i].picture, n, values[i]);
+    note_cell(jobs[i].picture->trail, n, REASON_DECISION, NULL);
+    jobs[i].region = region;
+    jobs[i].start = k + 1;
+    jobs[i].depth = depth + 1;
+    atomic_init(&jobs[i].branch.cancelled, false);
+    jobs[i].branch.parent = branch;
+    jobs[i].conflict = arena_alloc(ws->arena, levelset_size(depth + 1));
+    memset(jobs[i].conflict, 0, levelset_size(depth + 1));
+    jobs[i].limit = limit;
+    jobs[i].second = NULL;
+    if (second != NULL)
+      jobs[i].second = i == 0 ? second : arena_alloc(ws->arena, region->ncells * sizeof(bit));
+  }
+  init_task_group(&group);
+  spawn_task(&group, &task, search_task, jobs + 1);
+  search_task(jobs + 0);
+  if (jobs[0].count >= limit)
+    atomic_store(&jobs[1].branch.cancelled, true);
+  sync_tasks(&group);
+  count = jobs[0].count;
+  if (count > 0)
+  {
+    if (count < limit && jobs[1].count > 0)
+    {
+      if (count == 1 && second != NULL)
+        save_region(region, jobs[1].picture, second);
+      count += jobs[1].count < limit - count ? jobs[1].count : limit - count;
+    }
+    duplicate_picture(jobs[0].picture, mpicture);
+  }
+  else if (jobs[1].count > 0)
+  {
+    count = jobs[1].count;
+    if (count > 1 && second != NULL)
+      memcpy(second, jobs[1].second, region->ncells * sizeof(bit));
+    duplicate_picture(jobs[1].picture, mpicture);
+  }
+  else
+  {
+    // If one of the branches failed regardless of the decision, blame just
+    // its causes; otherwise, both of them.
+    if (!has_level(jobs[1].conflict, depth + 1))
+      i = 1;
+    else
+    {
+      i = 0;
+      if (has_level(jobs[0].conflict, depth + 1))
+      for (j = 0; j < levelset_size(depth + 1) / sizeof(uint64_t); j++)
+        jobs[0].conflict[j] |= jobs[1].conflict[j];
+    }
+    remove_level(jobs[i].conflict, depth + 1);
+    memcpy(conflict, jobs[i].conflict, levelset_size(depth));
+  }
+  arena_release(ws->arena, mark);
+  return count;
+}
+
+static uint64_t backtrack(Picture *mpicture, const Region *region, unsigned int start, unsigned int depth, SearchBranch *branch, uint64_t *conflict, uint64_t limit, bit *second)
+// Search the unknown cells of the region, from the start-th one on.
+// The earlier ones must be already known.
+// Return the number of solutions, but stop counting at the limit.
+// The first solution is put into the picture; the second one (if any)
+// into the second array, indexed like region->cells.
+// If there are no solutions, the conflict set tells which of the decisions
+// made so far (that is, levels 1 to depth) are to blame.
+{
+  Workspace *ws = get_workspace();
+  Trail *trail = mpicture->trail;
+  Picture *mclone, *xclone;
+  uint64_t *subconflict;
+  unsigned int k, n;
+  int line;
+  bool done = false;
+  bit first;
+  uint64_t count = 0, more;
+  uint64_t hash = mpicture->hash;
+  ArenaMark mark;
+
+  assert(trail != NULL);
+  count_stat(STAT_NODES);
+  memset(conflict, 0, levelset_size(depth));
+  if (charge_node())
+  {
+    checkpoint_search(mpicture, region);
+    fill_levelset(conflict, depth);
+    return 0;
+  }
+  checkpoint_search(mpicture, region);
+  if (trail->restart != NULL)
+    charge_restart(trail->restart);
+  count_stat(STAT_TT_PROBES);
+  if (probe_ttable(hash))
+  {
+    count_stat(STAT_TT_HITS);
+    fill_levelset(conflict, depth);
+    return 0;
+  }
+  mark = arena_mark(ws->arena);
+  mclone = arena_picture(ws->arena);
+  mclone->trail = trail;
+  for (k = start; k < region->ncells && !done; k++)
+  {
+    n = region->cells[k];
+    if (mpicture->bits[n] != Q)
+      continue;
+    done = true;
+    if (is_cancelled(branch))
+    {
+      checkpoint_search(mpicture, region);
+      count = 0;
+    }
+    else if (depth < split_depth)
+      count = split_search(mpicture, region, k, depth, branch, conflict, limit, second);
+    else if (is_resuming() && retrace_step(region, n))
+    {
+      // The first value failed before the checkpoint; the causes are lost,
+      // so blame all the decisions.
+      subconflict = arena_alloc(ws->arena, levelset_size(depth));
+      fill_levelset(subconflict, depth);
+      trail->level = depth;
+      assign_cell(mpicture, n, -first_value(trail));
+      note_cell(trail, n, REASON_NOGOOD, subconflict);
+      done = !propagate(mpicture, region, conflict);
+    }
+    else
+    {
+      TRACE(TRACE_DECISION, n, depth);
+      first = first_value(trail);
+      subconflict = arena_alloc(ws->arena, levelset_size(depth + 1));
+      memset(subconflict, 0, levelset_size(depth + 1));
+      duplicate_picture(mpicture, mclone); // mpicture --> mclone
+      trail->level = depth + 1;
+      assign_cell(mclone, n, first);
+      note_cell(trail, n, REASON_DECISION, NULL);
+      if (propagate(mclone, region, subconflict))
+        count = backtrack(mclone, region, k + 1, depth + 1, branch, subconflict, limit, second);
+      if (count > 0)
+      {
+        if (count < limit)
+        {
+          // Look for more solutions with the other value.
+          xclone = arena_picture(ws->arena);
+          xclone->trail = trail;
+          duplicate_picture(mpicture, xclone);
+          trail->level = depth + 1;
+          assign_cell(xclone, n, -first);
+          note_cell(trail, n, REASON_DECISION, NULL);
+          more = 0;
+          if (propagate(xclone, region, subconflict))
+            more = backtrack(xclone, region, k + 1, depth + 1, branch, subconflict, limit - count, NULL);
+          if (more > 0 && count == 1 && second != NULL)
+            save_region(region, xclone, second);
+          count += more;
+        }
+        duplicate_picture(mclone, mpicture); // mclone --> mpicture
+      }
+      else if (is_cancelled(branch))
+      {
+        // The failure doesn't prove anything, so don't learn from it.
+      }
+      else if (!has_level(subconflict, depth + 1))
+      {
+        // The decision had nothing to do with the failure,
+        // so the other value would fail the same way.
+        count_stat(STAT_BACKJUMPS);
+        memcpy(conflict, subconflict, levelset_size(depth));
+      }
+      else
+      {
+        TRACE(TRACE_REFUTATION, n, depth);
+        count_stat(STAT_NOGOODS);
+        remove_level(subconflict, depth + 1);
+        trail->level = depth;
+        assign_cell(mpicture, n, -first);
+        note_cell(trail, n, REASON_NOGOOD, subconflict);
+        done = !propagate(mpicture, region, conflict);
+      }
+    }
+  }
+  if (!done)
+  {
+    line = find_inconsistency(mpicture->bits, region);
+    count = line < 0;
+    if (count == 0)
+      analyze_conflict(mpicture, line, conflict);
+  }
+  // The nogoods must outlive the conflict analysis.
+  arena_release(ws->arena, mark);
+  // The result of a cancelled search doesn't prove anything.
+  if (count == 0 && !is_cancelled(branch))
+  {
+    count_stat(STAT_TT_STORES);
+    store_ttable(hash);
+  }
+  return count;
+}
+
+static inline unsigned int find_root(unsigned int *parent, unsigned int x)
+{
+  while (parent[x] != x)
+    x = parent[x] = parent[parent[x]];
+  return x;
+}
+
+static inline unsigned int order_cell(CellOrder order, unsigned int k)
+// Return the k-th cell in the given order.
+{
+  switch (order)
+  {
+  case ORDER_COLUMNS:
+    return (k % ysize) * xsize + k / ysize;
+  case ORDER_REVERSE:
+    return vsize - 1 - k;
+  case ORDER_REVERSE_COLUMNS:
+    return vsize - 1 - ((k % ysize) * xsize + k / ysize);
+  default:
+    return k;
+  }
+}
+
+static unsigned int decompose(Picture *mpicture, CellOrder order, Arena *arena, Region **result)
+// Split the unknown cells into independent regions:
+// two cells are connected if they share a line.
+// Return the number of regions.
+{
+  Region *regions;
+  unsigned int *parent, *index, *cell_index;
+  unsigned int i, j, k, n, count;
   bit *picture;
-  unsigned int i, j, n;
-  bool res = false;
 
-  mclone = alloc_picture();
+  parent = arena_alloc(arena, xpysize * sizeof(unsigned int));
+  index = arena_alloc(arena, xpysize * sizeof(unsigned int));
+  for (i = 0; i < xpysize; i++)
+    parent[i] = i;
   picture = mpicture->bits;
-  n = 0;
-  for (i = 0; i < ysize && !res; i++)
-  for (j = 0; j < xsize && !res; j++, n++, picture++)
+  for (i = 0; i < ysize; i++)
+  for (j = 0; j < xsize; j++, picture++)
   if (*picture == Q)
+    parent[find_root(parent, i)] = find_root(parent, ysize + j);
+
+  count = 0;
+  for (i = 0; i < xpysize; i++)
+    index[i] = (unsigned int)-1;
+  for (i = 0; i < xpysize; i++)
+  if (mpicture->linecounter[i] > 0)
   {
-    duplicate_picture(mpicture, mclone); // mpicture --> mclone
-    mclone->bits[n] = O;
-    mclone->counter--;
-    mclone->linecounter[i]--;
-    mclone->linecounter[ysize + j]--;
-    shake(mclone);
-    res = backtrack(mclone);
-    if (res)
-      duplicate_picture(mclone, mpicture); // mclone --> mpicture
-    else
+    n = find_root(parent, i);
+    if (index[n] == (unsigned int)-1)
+      index[n] = count++;
+    index[i] = index[n];
+  }
+
+  regions = arena_alloc(arena, count * sizeof(Region));
+  memset(regions, 0, count * sizeof(Region));
+  for (i = 0; i < xpysize; i++)
+  if (mpicture->linecounter[i] > 0)
+  {
+    regions[index[i]].nlines++;
+    if (i < ysize)
+      regions[index[i]].ncells += mpicture->linecounter[i];
+  }
+  cell_index = arena_alloc(arena, vsize * sizeof(unsigned int));
+  for (n = 0; n < vsize; n++)
+    cell_index[n] = NO_CELL;
+  for (i = 0; i < count; i++)
+  {
+    regions[i].cell_index = cell_index;
+    regions[i].lines = arena_alloc(arena, regions[i].nlines * sizeof(unsigned int));
+    regions[i].cells = arena_alloc(arena, regions[i].ncells * sizeof(unsigned int));
+    regions[i].nlines = regions[i].ncells = 0;
+  }
+  for (i = 0; i < xpysize; i++)
+  if (mpicture->linecounter[i] > 0)
+  {
+    Region *region = regions + index[i];
+    region->lines[region->nlines++] = i;
+  }
+  for (k = 0; k < vsize; k++)
+  if (mpicture->bits[n = order_cell(order, k)] == Q)
+  {
+    Region *region = regions + index[n / xsize];
+    cell_index[n] = region->ncells;
+    region->cells[region->ncells++] = n;
+  }
+  *result = regions;
+  return count;
+}
+
+static Restart *alloc_restart(Arena *arena, Region *region, SearchBranch *branch)
+{
+  Restart *tmp = arena_alloc(arena, sizeof(Restart));
+  tmp->region = region;
+  // Every region gets its own sequence of random numbers,
+  // so that the runs are reproducible even with many workers.
+  tmp->random = random_seed ^ (uint64_t)(region->cells[0] + 1) << 32;
+  atomic_init(&tmp->nodes, 0);
+  tmp->budget = 0;
+  tmp->branch = branch;
+  tmp->first = O;
+  return tmp;
+}
+
+static void reorder_region(Restart *restart, Trail *trail)
+// Pick at random the order of the cells for the next run (keeping the trail
+// in sync with it) and the value to try first.
+// Random permutations of the cells (or even of whole lines) turn out to make
+// the search much slower than the orders that complete lines one by one.
+{
+  Workspace *ws = get_workspace();
+  ArenaMark mark = arena_mark(ws->arena);
+  Region *region = restart->region;
+  CellOrder order = random_below(&restart->random, ORDER_COUNT);
+  unsigned int *cells;
+  CellReason *reasons;
+  unsigned int i, j, k, n;
+
+  cells = arena_alloc(ws->arena, region->ncells * sizeof(unsigned int));
+  reasons = arena_alloc(ws->arena, region->ncells * sizeof(CellReason));
+  for (k = 0, i = 0; k < vsize; k++)
+  {
+    n = order_cell(order, k);
+    j = region->cell_index[n];
+    if (j < region->ncells && region->cells[j] == n)
     {
-      *picture = X;
-      mpicture->counter--;
-      mpicture->linecounter[i]--;
-      mpicture->linecounter[ysize + j]--;
-      shake(mpicture);
+      cells[i] = n;
+      reasons[i++] = trail->cells[j];
+    }
+  }
+  assert(i == region->ncells);
+  memcpy(region->cells, cells, i * sizeof(unsigned int));
+  memcpy(trail->cells, reasons, i * sizeof(CellReason));
+  for (i = 0; i < region->ncells; i++)
+    region->cell_index[region->cells[i]] = i;
+  restart->first = random_below(&restart->random, 2) ? X : O;
+  arena_release(ws->arena, mark);
+}
+
+static uint64_t restart_search(Picture *mpicture, const Region *region, SearchBranch *branch, uint64_t *conflict)
+// Search the region in a series of runs, each with a random order of cells
+// and values, and a budget of nodes that follows the Luby sequence.
+// Whatever a run has proven at the root level is kept for the next ones.
+{
+  Restart *restart = mpicture->trail->restart;
+  unsigned int i;
+  uint64_t count;
+
+  for (i = 0; ; i++)
+  {
+    reorder_region(restart, mpicture->trail);
+    atomic_store(&restart->nodes, 0);
+    restart->budget = (uint64_t) RESTART_UNIT * luby(i);
+    count = backtrack(mpicture, region, 0, 0, branch, conflict, 1, NULL);
+    if (count > 0 || !atomic_load(&branch->cancelled) || is_cancelled(branch->parent))
+      return count;
+    count_stat(STAT_RESTARTS);
+    atomic_store(&branch->cancelled, false);
+  }
+}
+
+static void region_task(void *arg)
+{
+  SearchJob *job = arg;
+  uint64_t conflict;
+  if (job->picture->trail->restart != NULL)
+    job->count = restart_search(job->picture, job->region, &job->branch, &conflict);
+  else
+    job->count = backtrack(job->picture, job->region, 0, 0, &job->branch, &conflict, job->limit, job->second);
+}
+
+static uint64_t search(Picture *mpicture, const Strategy *strategy, SearchBranch *branch, uint64_t limit, bit *second)
+// Search each region separately (and in parallel),
+// then put the pieces together.
+// Return the number of solutions, but stop counting at the limit.
+// The first solution is put into the picture; the second one (if any)
+// into the second array, unless it's NULL.
+{
+  Workspace *ws = get_workspace();
+  ArenaMark mark = arena_mark(ws->arena), batch_mark;
+  Region *regions;
+  const Region *alt_region = NULL;
+  SearchJob *jobs;
+  Task *tasks;
+  TaskGroup group;
+  unsigned int i, j, k, n, batch, nregions;
+  uint64_t count = 1;
+  bit *alt = NULL;
+
+  nregions = decompose(mpicture, strategy->order, ws->arena, &regions);
+  add_stat(STAT_REGIONS, nregions);
+  resume_search(mpicture, regions);
+  batch = get_worker_count();
+  jobs = arena_alloc(ws->arena, batch * sizeof(SearchJob));
+  tasks = arena_alloc(ws->arena, batch * sizeof(Task));
+  for (i = 0; i < batch; i++)
+    jobs[i].picture = arena_picture(ws->arena);
+  if (second != NULL)
+    alt = arena_alloc(ws->arena, vsize * sizeof(bit));
+  for (k = 0; k < nregions && count > 0; k += batch)
+  {
+    if (batch > nregions - k)
+      batch = nregions - k;
+    batch_mark = arena_mark(ws->arena);
+    init_task_group(&group);
+    for (i = 0; i < batch; i++)
+    {
+      duplicate_picture(mpicture, jobs[i].picture);
+      jobs[i].region = regions + k + i;
+      jobs[i].picture->trail = alloc_trail(ws->arena, jobs[i].region, strategy);
+      atomic_init(&jobs[i].branch.cancelled, false);
+      jobs[i].branch.parent = branch;
+      // Restarts only help to find the first solution.
+      if (strategy->restarts && limit == 1)
+        jobs[i].picture->trail->restart = alloc_restart(ws->arena, regions + k + i, &jobs[i].branch);
+      jobs[i].limit = limit;
+      jobs[i].second = NULL;
+      if (second != NULL && alt_region == NULL)
+        jobs[i].second = arena_alloc(ws->arena, jobs[i].region->ncells * sizeof(bit));
+      if (i > 0)
+        spawn_task(&group, tasks + i, region_task, jobs + i);
+    }
+    region_task(jobs);
+    sync_tasks(&group);
+    for (i = 0; i < batch; i++)
+    {
+      // The regions are independent, so their numbers of solutions multiply.
+      if (jobs[i].count == 0)
+        count = 0;
+      else if (count > limit / jobs[i].count)
+        count = limit;
+      else
+        count *= jobs[i].count;
+      if (jobs[i].count > 1 && jobs[i].second != NULL && alt_region == NULL)
+      {
+        alt_region = jobs[i].region;
+        for (j = 0; j < alt_region->ncells; j++)
+          alt[alt_region->cells[j]] = jobs[i].second[j];
+      }
+      // A region that hasn't been solved (because the budget ran out)
+      // holds guesses rather than deductions.
+      if (jobs[i].count == 0)
+        continue;
+      for (j = 0; j < jobs[i].region->ncells; j++)
+      {
+        n = jobs[i].region->cells[j];
+        if (mpicture->bits[n] == Q && jobs[i].picture->bits[n] != Q)
+          assign_cell(mpicture, n, jobs[i].picture->bits[n]);
+      }
+    }
+    arena_release(ws->arena, batch_mark);
+  }
+  if (count > 0 && !check_consistency(mpicture->bits))
+    count = 0;
+  if (count > 1 && second != NULL)
+  {
+    // The second solution differs from the first one in a single region.
+    memcpy(second, mpicture->bits, vsize * sizeof(bit));
+    for (j = 0; j < alt_region->ncells; j++)
+      second[alt_region->cells[j]] = alt[alt_region->cells[j]];
+  }
+  arena_release(ws->arena, mark);
+  return count;
+}
+
+static uint64_t sat_search(Picture *mpicture, SearchBranch *branch, uint64_t limit, bit *second)
+// Hand the unknown cells over to the SAT solver.
+// To count the solutions, every one found is ruled out by a new clause,
+// and the solver is run again.
+{
+  const atomic_bool *stop = branch != NULL ? &branch->cancelled : NULL;
+  Cnf *cnf = alloc_cnf();
+  unsigned int *cellvars = alloc(vsize * sizeof(unsigned int));
+  int *blocking = alloc(vsize * sizeof(int));
+  unsigned int i, n;
+  uint64_t count = 0;
+  bool *model;
+
+  encode_picture(mpicture, cnf, cellvars);
+  model = alloc((cnf->nvars + 1) * sizeof(bool));
+  while (count < limit && solve_cnf(cnf, model, stop))
+  {
+    if (count == 1 && second != NULL)
+    {
+      memcpy(second, mpicture->bits, vsize * sizeof(bit));
+      for (n = 0; n < vsize; n++)
+      if (cellvars[n] > 0)
+        second[n] = model[cellvars[n]] ? X : O;
+    }
+    for (n = 0, i = 0; n < vsize; n++)
+    if (cellvars[n] > 0)
+    {
+      if (count == 0)
+        assign_cell(mpicture, n, model[cellvars[n]] ? X : O);
+      blocking[i++] = model[cellvars[n]] ? -(int)cellvars[n] : (int)cellvars[n];
+    }
+    add_clause(cnf, blocking, i);
+    count++;
+  }
+  free(model);
+  free(blocking);
+  free(cellvars);
+  free_cnf(cnf);
+  if (count > 0 && !check_consistency(mpicture->bits))
+    count = 0;
+  return count;
+}
+
+static uint64_t local_search_picture(Picture *mpicture, SearchBranch *branch)
+// Let the local search fill in the unknown cells.
+// It returns only when it has found a solution or has been stopped.
+{
+  const atomic_bool *stop = branch != NULL ? &branch->cancelled : NULL;
+  bit *bits = alloc(vsize * sizeof(bit));
+  unsigned int n;
+  bool res;
+
+  memcpy(bits, mpicture->bits, vsize * sizeof(bit));
+  res = local_search(bits, stop, random_seed);
+  if (res)
+  for (n = 0; n < vsize; n++)
+  if (mpicture->bits[n] == Q)
+    assign_cell(mpicture, n, bits[n]);
+  free(bits);
+  return res && check_consistency(mpicture->bits);
+}
+
+static uint64_t run_strategy(Picture *mpicture, const Strategy *strategy, SearchBranch *branch, uint64_t limit, bit *second)
+{
+  switch (strategy->engine)
+  {
+  case ENGINE_SAT:
+    return sat_search(mpicture, branch, limit, second);
+  case ENGINE_LOCAL:
+    return local_search_picture(mpicture, branch);
+  default:
+    return search(mpicture, strategy, branch, limit, second);
+  }
+}
+
+uint64_t search_picture(Picture *mpicture, uint64_t limit)
+// Search for up to limit solutions, with the SAT solver if asked to.
+// The first one is left in the picture.
+{
+  return run_strategy(mpicture, config.sat ? SAT_STRATEGY : DEFAULT_STRATEGY, NULL, limit, NULL);
+}
+
+static void portfolio_task(void *arg)
+{
+  PortfolioJob *job = arg;
+  unsigned int i;
+  int none = -1;
+
+  job->count = run_strategy(job->picture, job->strategy, &job->branch, job->limit, job->second);
+  // The first one to finish wins; the others are no longer needed.
+  if (atomic_compare_exchange_strong(job->winner, &none, (int) job->index))
+  for (i = 0; i < job->njobs; i++)
+  if (i != job->index)
+    atomic_store(&job->jobs[i].branch.cancelled, true);
+}
+
+static uint64_t run_portfolio(Picture *mpicture, uint64_t limit, bit *second, const Strategy **winner)
+// Race as many strategies as there are workers against each other,
+// and take the result of the first one to finish.
+{
+  Workspace *ws = get_workspace();
+  ArenaMark mark = arena_mark(ws->arena);
+  PortfolioJob *jobs;
+  Task *tasks;
+  TaskGroup group;
+  atomic_int first;
+  unsigned int i, n = get_worker_count();
+  uint64_t count;
+
+  if (n > STRATEGY_COUNT)
+    n = STRATEGY_COUNT;
+  jobs = arena_alloc(ws->arena, n * sizeof(PortfolioJob));
+  tasks = arena_alloc(ws->arena, n * sizeof(Task));
+  atomic_init(&first, -1);
+  for (i = 0; i < n; i++)
+  {
+    jobs[i].strategy = strategies + i;
+    jobs[i].picture = arena_picture(ws->arena);
+    duplicate_picture(mpicture, jobs[i].picture);
+    jobs[i].picture->trail = NULL;
+    atomic_init(&jobs[i].branch.cancelled, false);
+    jobs[i].branch.parent = NULL;
+    jobs[i].limit = limit;
+    jobs[i].second = second != NULL ? arena_alloc(ws->arena, vsize * sizeof(bit)) : NULL;
+    jobs[i].jobs = jobs;
+    jobs[i].index = i;
+    jobs[i].njobs = n;
+    jobs[i].winner = &first;
+  }
+  init_task_group(&group);
+  for (i = 1; i < n; i++)
+    spawn_task(&group, tasks + i, portfolio_task, jobs + i);
+  portfolio_task(jobs);
+  sync_tasks(&group);
+  i = atomic_load(&first);
+  count = jobs[i].count;
+  duplicate_picture(jobs[i].picture, mpicture);
+  if (count > 1 && second != NULL)
+    memcpy(second, jobs[i].second, vsize * sizeof(bit));
+  *winner = jobs[i].strategy;
+  arena_release(ws->arena, mark);
+  return count;
+}
+
+static void export_dimacs(Picture *mpicture, const char *filename)
+{
+  Cnf *cnf = alloc_cnf();
+  unsigned int *cellvars = alloc(vsize * sizeof(unsigned int));
+  FILE *file;
+  bool res;
+
+  encode_picture(mpicture, cnf, cellvars);
+  file = fopen(filename, "w");
+  res = file != NULL && write_dimacs(cnf, file);
+  if (file != NULL && fclose(file) != 0)
+    res = false;
+  if (!res)
+    perror(filename);
+  free(cellvars);
+  free_cnf(cnf);
+}
+
+static inline bool use_cache(void)
+// The cache holds any one solution, which may not agree with the given cells.
+{
+  return config.cache_dir != NULL && config.solutions == 1 && config.given_file == NULL;
+}
+
+static bool load_cached_solution(Picture *mpicture)
+// Take the solution from the cache, provided that it really is one.
+{
+  bit *bits;
+  bool found;
+
+  if (!use_cache())
+    return false;
+  bits = alloc(vsize * sizeof(bit));
+  found = lookup_cache(config.cache_dir, bits) && check_consistency(bits);
+  if (found)
+  {
+    memcpy(mpicture->bits, bits, vsize * sizeof(bit));
+    mpicture->counter = 0;
+  }
+  free(bits);
+  return found;
+}
+
+static bool report_given_error(const char *filename, unsigned int i, unsigned int j, const char *what)
+{
+  fprintf(stderr, "%s: %s at row %u, column %u!\n", filename, what, i + 1, j + 1);
+  return false;
+}
+
+static bool load_given_cells(Picture *mpicture, const char *filename)
+// Set the cells that are known in advance. The file has a line per row and a
+// character per cell: “#” for filled, “.” for empty, and “?” for unknown.
+// Missing cells are unknown.
+// Return false if the file is malformed or contradicts the cells already
+// deduced by preliminary_shake().
+{
+  FILE *file;
+  unsigned int i, j, n;
+  int c;
+  bit value;
+  bool res = true;
+
+  file = fopen(filename, "r");
+  if (file == NULL)
+  {
+    perror(filename);
+    return false;
+  }
+  i = j = 0;
+  while (res && (c = getc(file)) != EOF)
+  {
+    if (c == '\r')
+      continue;
+    if (c == '\n')
+    {
+      i++;
+      j = 0;
+      continue;
+    }
+    if (i >= (transposed ? xsize : ysize) || j >= (transposed ? ysize : xsize))
+    {
+      res = report_given_error(filename, i, j, "Cell outside the grid");
+      break;
+    }
+    switch (c)
+    {
+    case '#':
+      value = X;
+      break;
+    case '.':
+      value = O;
+      break;
+    case '?':
+      value = Q;
+      break;
+    default:
+      res = report_given_error(filename, i, j, "Invalid cell");
+      continue;
     }
+    n = grid_cell(i, j++);
+    if (value == Q || mpicture->bits[n] == value)
+      continue;
+    if (mpicture->bits[n] == Q)
+      assign_cell(mpicture, n, value);
+    else
+      res = report_given_error(filename, i, j - 1, "Cell contradicting the clues");
   }
-  free_picture(mclone);
-  return check_consistency(mpicture->bits);
+  fclose(file);
+  return res;
 }
 
 static unsigned int measure_evil(int r, int k)
@@ -718,60 +2487,73 @@ static unsigned int measure_evil(int r, int k)
   return floor(tmp * MAX_EVIL * MAX_FACTOR);
 }
 
-int main(int argc, char **argv)
+static bool read_block_color(FILE *file, char *c, unsigned int *color)
+// Read the name of a color that follows a block length, if any;
+// a block without one has the first color.
+// Return false if the color is unknown.
 {
-  char c;
-  int rc;
-  unsigned int i, j, k, sane;
-  unsigned int evs, evm;
-  bit *checkbits = NULL;
-  double starttime, endtime;
+  *color = 1;
+  if (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n' || *c == '\0')
+    return true;
+  *color = find_color(*c);
+  *c = freadchar(file);
+  return *color != 0;
+}
 
-#if ENABLE_DEBUG
-  FILE *verifyfile;
-  Picture *checkpicture;
-#endif
-  static char *verifyfname = NULL;
+static void setup_puzzle(void)
+// Allocate everything that depends on the size and the colors.
+{
+  vsize = xsize * ysize;
+  xpysize = xsize + ysize;
+  xysize = xsize > ysize ? xsize : ysize; // max(xsize, ysize)
 
-  setup_sigint();
+  lmax = tmax = 1;
+  if (ncolors > 0)
+    setup_colors();
+  leftborder = alloc_border(left_offset(ysize));
+  topborder = alloc_border(top_offset(xsize));
+  setup_workspaces();
+  mainpicture = alloc_picture();
+}
 
-  parse_arguments(argc, argv, &verifyfname);
+bool read_puzzle(FILE *file)
+// Read the size and the clues, and set up everything that depends on them.
+// On invalid input, complain and return false.
+{
+  char c;
+  unsigned int i, j, k, sane, color, skip, most;
+  unsigned int evs, evm;
 
   xsize = ysize = 0;
-  c = readchar();
+  c = freadchar(file);
   while (c >= '0' && c <= '9')
   {
     xsize *= 10;
     xsize += c - '0';
-    c = readchar();
+    c = freadchar(file);
   }
   while (c == ' ' || c == '\t')
-    c = readchar();
+    c = freadchar(file);
   while (c >= '0' && c <= '9')
   {
     ysize *= 10;
     ysize += c - '0';
-    c = readchar();
+    c = freadchar(file);
   }
-  while (c <= ' ')
-    c = readchar();
-
-  if (xsize < 1 || ysize < 1 || xsize > MAX_SIZE || ysize > MAX_SIZE)
-    raise_input_error(1);
-
-  vsize = xsize * ysize;
-  xpysize = xsize + ysize;
-  xysize = xsize > ysize ? xsize : ysize; // max(xsize, ysize)
+  while (c != '\0' && c <= ' ')
+    c = freadchar(file);
 
-  leftborder = alloc_border();
-  topborder = alloc_border();
-  gtestfield = alloc_testfield();
+  if (xsize < 1 || ysize < 1 || xsize > config.max_size || ysize > config.max_size)
+    return report_input_error(1);
 
-  mainpicture = alloc_picture();
+  if (read_colors(file, &c) < 0)
+    return report_input_error(2 + ncolors);
+  skip = ncolors;
+  setup_puzzle();
 
   evs = evm = 0;
   sane = (unsigned int) -1;
-  lmax = 0;
+  most = 1;
   for (i = j = 0; i < ysize; )
   {
     k = 0;
@@ -779,36 +2561,47 @@ int main(int argc, char **argv)
     {
       k *= 10;
       k += c-'0';
-      c = readchar();
+      c = freadchar(file);
     }
     sane += k + 1;
+    make_room(true, j + 1);
+    if (ncolors > 0)
+    {
+      if (!read_block_color(file, &c, &color))
+        return report_input_error(2 + skip + i);
+      leftcolors[left_offset(i) + j] = color;
+      // Blocks of different colors need no gap between them.
+      if (j > 0 && leftcolors[left_offset(i) + j - 1] != color)
+        sane--;
+    }
     if ((sane>xsize) || (k == 0 && j > 0))
-      raise_input_error(2 + i);
-    leftborder[i * xsize + j] = k;
+      return report_input_error(2 + skip + i);
+    leftborder[left_offset(i) + j] = k;
     evs += k;
     if (k > evm)
       evm = k;
     while (c == ' ' || c == '\t')
-      c = readchar();
+      c = freadchar(file);
     if (c == '\r' || c == '\n' || c == '\0')
     {
-      if (j > lmax)
-        lmax = j;
+      if (j + 1 > most)
+        most = j + 1;
       mainpicture->evilcounter[i] = measure_evil(xsize - evs + 1, j + 1);
       evs = evm = 0;
       i++;
       j = 0;
       sane = (unsigned int) -1;
       do
-        c = readchar();
+        c = freadchar(file);
       while (c == '\r' || c == '\n');
     }
     else
       j++;
   }
 
+  restride_clues(true, most);
   assert(sane == (unsigned int)-1);
-  tmax = 0;
+  most = 1;
   for (i = j = 0; i < xsize; )
   {
     k = 0;
@@ -816,36 +2609,421 @@ int main(int argc, char **argv)
     {
       k *= 10;
       k += c-'0';
-      c = readchar();
+      c = freadchar(file);
     }
     sane += k + 1;
+    make_room(false, j + 1);
+    if (ncolors > 0)
+    {
+      if (!read_block_color(file, &c, &color))
+        return report_input_error(2 + skip + ysize + i);
+      topcolors[top_offset(i) + j] = color;
+      if (j > 0 && topcolors[top_offset(i) + j - 1] != color)
+        sane--;
+    }
     if ((sane > ysize) || (k == 0 && j > 0))
-      raise_input_error(2 + ysize + i);
-    topborder[i * ysize + j] = k;
+      return report_input_error(2 + skip + ysize + i);
+    topborder[top_offset(i) + j] = k;
     evs += k;
     if (k > evm)
       evm = k;
     while (c == ' ' || c == '\t')
-      c = readchar();
+      c = freadchar(file);
     if (c == '\r' || c == '\n' || c == '\0')
     {
-      if (j > tmax)
-        tmax = j;
+      if (j + 1 > most)
+        most = j + 1;
       mainpicture->evilcounter[ysize + i] = measure_evil(ysize - evs + 1, j + 1);
       evs = evm = 0;
       i++;
       j = 0;
       sane = (unsigned int) -1;
+      // Don't read past the puzzle: a session reads commands after it.
+      if (i == xsize)
+        break;
       do
-        c = readchar();
+        c = freadchar(file);
       while (c=='\r' || c=='\n');
     }
     else
       j++;
   }
 
-  lmax++;
-  tmax++;
+  restride_clues(false, most);
+  return true;
+}
+
+static bool read_packed_puzzle(const uint16_t *words, size_t nwords)
+// Set up a puzzle from a pack, taking its clues straight from the mapping.
+// Return false if the puzzle is corrupted.
+{
+  unsigned int i, j, n, line, size, sum, used, lmost, tmost;
+  unsigned int *border;
+  unsigned char *blockcolors = NULL;
+  size_t p;
+
+  if (nwords < 3)
+    return false;
+  xsize = words[0];
+  ysize = words[1];
+  if (xsize < 1 || ysize < 1 || xsize > config.max_size || ysize > config.max_size || words[2] > MAX_COLORS || nwords < (size_t) 3 * words[2] + 3)
+    return false;
+  ncolors = words[2];
+  for (i = 1; i <= ncolors; i++)
+  {
+    colors[i].name = words[3 * i];
+    colors[i].rgb = (unsigned int) words[3 * i + 1] << 16 | words[3 * i + 2];
+  }
+  p = 3 + 3 * ncolors;
+  setup_puzzle();
+
+  lmost = tmost = 1;
+  for (line = 0; line < xpysize; line++)
+  {
+    size = line < ysize ? xsize : ysize;
+    if (p >= nwords)
+      return false;
+    n = words[p++];
+    if (n > size || nwords - p < (ncolors > 0 ? 2 * n : n))
+      return false;
+    make_room(line < ysize, n);
+    if (line < ysize)
+    {
+      border = leftborder + left_offset(line);
+      if (ncolors > 0)
+        blockcolors = leftcolors + left_offset(line);
+    }
+    else
+    {
+      border = topborder + top_offset(line - ysize);
+      if (ncolors > 0)
+        blockcolors = topcolors + top_offset(line - ysize);
+    }
+    sum = used = 0;
+    for (j = 0; j < n; j++)
+    {
+      border[j] = words[p + j];
+      if (border[j] == 0)
+        return false;
+      sum += border[j];
+      used += border[j] + (j > 0);
+      if (ncolors > 0)
+      {
+        blockcolors[j] = words[p + n + j];
+        if (blockcolors[j] < 1 || blockcolors[j] > ncolors)
+          return false;
+        // Blocks of different colors need no gap between them.
+        if (j > 0 && blockcolors[j - 1] != blockcolors[j])
+          used--;
+      }
+    }
+    if (used > size)
+      return false;
+    p += ncolors > 0 ? 2 * n : n;
+    mainpicture->evilcounter[line] = measure_evil(size - sum + 1, n > 0 ? n : 1);
+    if (line < ysize && n > lmost)
+      lmost = n;
+    if (line >= ysize && n > tmost)
+      tmost = n;
+  }
+  restride_clues(true, lmost);
+  restride_clues(false, tmost);
+  return p == nwords;
+}
+
+bool set_clues(unsigned int line, const unsigned int *clues, unsigned int nclues)
+// Replace the clues of a line. Return false if they don't fit.
+{
+  unsigned int i, size, sum, max, lmost, tmost, *border;
+
+  if (nclues == 1 && clues[0] == 0)
+    nclues = 0;
+  size = line < ysize ? xsize : ysize;
+  sum = 0;
+  for (i = 0; i < nclues; i++)
+  {
+    if (clues[i] == 0 || clues[i] > size)
+      return false;
+    sum += clues[i];
+  }
+  if (nclues > 0 && sum + nclues - 1 > size)
+    return false;
+
+  make_room(line < ysize, nclues);
+  if (line < ysize)
+    border = leftborder + left_offset(line), max = lmax;
+  else
+    border = topborder + top_offset(line - ysize), max = tmax;
+  for (i = 0; i <= max; i++)
+    border[i] = i < nclues ? clues[i] : 0;
+  mainpicture->evilcounter[line] = measure_evil(size - sum + 1, nclues > 0 ? nclues : 1);
+
+  // The longest lists of clues may have changed.
+  lmost = tmost = 1;
+  for (i = 0; i < ysize; i++)
+    while (lmost < lmax && leftborder[left_offset(i) + lmost] > 0)
+      lmost++;
+  for (i = 0; i < xsize; i++)
+    while (tmost < tmax && topborder[top_offset(i) + tmost] > 0)
+      tmost++;
+  restride_clues(true, lmost);
+  restride_clues(false, tmost);
+  return true;
+}
+
+void free_puzzle(void)
+{
+  free_colors();
+  stop_resuming();
+  free(mainpicture);
+  free(leftborder);
+  free(topborder);
+  mainpicture = NULL;
+  leftborder = topborder = NULL;
+  transposed = false;
+}
+
+static int solve_color_puzzle(void)
+// Solve the colored puzzle that has been read, and print the results.
+// Return the exit status.
+{
+  int rc = EXIT_SUCCESS;
+  domain *cells, *second = NULL;
+  uint64_t solutions;
+  double starttime, endtime;
+
+  if (config.sat || config.portfolio || config.restarts || config.local_search ||
+      config.dimacs_file != NULL || config.given_file != NULL || use_cache() ||
+      config.checkpoint_file != NULL || config.resume_file != NULL)
+  {
+    fprintf(stderr, "Colored puzzles can be solved only by line solving and backtracking!\n");
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+
+  reset_stats();
+  cells = alloc(vsize * sizeof(domain));
+  if (config.solutions > 1)
+    second = alloc(vsize * sizeof(domain));
+
+  starttime = get_time();
+  start_budget();
+  solutions = solve_colors(cells, config.solutions, second);
+  endtime = get_time();
+
+  if (solutions > 0)
+  {
+    print_color_picture(cells);
+    if (solutions > 1)
+      print_color_picture(second);
+  }
+  else if (!is_out_of_budget())
+  {
+    rc = EXIT_FAILURE;
+    reset_stats();
+    fprintf(stderr, "Inconsistent puzzle!\n");
+  }
+
+  if (solutions < config.solutions && is_out_of_budget())
+  {
+    rc = EXIT_INCOMPLETE;
+    fprintf(stderr, "%s!\n", describe_budget());
+    if (solutions == 0)
+      print_color_picture(cells);
+  }
+
+  if (config.solutions > 1 && (solutions > 0 || rc != EXIT_INCOMPLETE))
+  {
+    if (solutions == config.solutions || rc == EXIT_INCOMPLETE)
+      printf("Solutions: %ju or more\n", (uintmax_t) solutions);
+    else
+      printf("Solutions: %ju\n", (uintmax_t) solutions);
+    if (config.unique && solutions != 1 && rc != EXIT_INCOMPLETE)
+      rc = EXIT_FAILURE;
+  }
+
+  printf("Processing time: %.2f sec\n", endtime-starttime);
+  printf("%ju\n", get_stat(STAT_LINE_SOLVES));
+  if (config.stats)
+  {
+    print_stats();
+    printf("Strategy: colors\n");
+  }
+  fflush(stdout);
+  free(cells);
+  free(second);
+  free_puzzle();
+  return rc;
+}
+
+static double estimate_line_work(unsigned int line)
+// Return about how many cells solving the line visits at worst,
+// regardless of its known cells. Crowded lines are settled instead,
+// so none of them counts for more than TOUCH_MAX_WORK.
+{
+  double work = count_placements_ln(line) + log(line < ysize ? xsize : ysize);
+
+  return work < log(TOUCH_MAX_WORK) ? exp(work) : TOUCH_MAX_WORK;
+}
+
+static void orient_puzzle(void)
+// Rows are contiguous in memory, and columns are not: if solving the columns
+// looks much costlier than solving the rows, swap them, so that the costly
+// lines are the contiguous ones. Nearly square puzzles are kept as they are,
+// because transposing changes the order of the search, too.
+// The picture is swapped back for printing.
+{
+  unsigned int i;
+  unsigned int *counters;
+  double rows = 0.0, columns = 0.0;
+
+  if (config.orientation == ORIENT_KEEP || config.dimacs_file != NULL)
+    return;
+  if (config.orientation == ORIENT_AUTO)
+  {
+    for (i = 0; i < ysize; i++)
+      rows += estimate_line_work(i);
+    for (i = ysize; i < xpysize; i++)
+      columns += estimate_line_work(i);
+    if (columns <= ORIENT_MARGIN * rows)
+      return;
+  }
+  // Line counters of the columns come first now, and so does their evilness.
+  counters = alloc(2 * xpysize * sizeof(unsigned int));
+  memcpy(counters, mainpicture->linecounter, 2 * xpysize * sizeof(unsigned int));
+  for (i = 0; i < xpysize; i++)
+  {
+    mainpicture->linecounter[i] = counters[(i + ysize) % xpysize];
+    mainpicture->evilcounter[i] = counters[xpysize + (i + ysize) % xpysize];
+  }
+  free(counters);
+  swap_axes();
+  transposed = true;
+}
+
+static double estimate_difficulty(Picture *mpicture)
+// Return log10 of an upper bound on the number of ways to fill the unknown
+// cells: as few as the rows, or the columns, that are still unsolved can be
+// placed, and at most 2^n for n cells.
+{
+  unsigned int i;
+  double rows = 0.0, columns = 0.0, cells;
+
+  for (i = 0; i < ysize; i++)
+    if (mpicture->linecounter[i] > 0)
+      rows += count_placements_ln(i);
+  for (i = ysize; i < xpysize; i++)
+    if (mpicture->linecounter[i] > 0)
+      columns += count_placements_ln(i);
+  cells = mpicture->counter * log(2.0);
+  if (rows > columns)
+    rows = columns;
+  if (rows > cells)
+    rows = cells;
+  return rows / log(10.0);
+}
+
+static int classify_read_puzzle(void)
+// Line-solve the puzzle that has been read, without any search and within
+// the budget, then report how far that got and how hard the rest looks.
+// Return the exit status.
+{
+  int rc = EXIT_SUCCESS;
+  unsigned int i, line;
+  const char *solvable;
+  double starttime, endtime;
+  Workspace *ws = get_workspace();
+  Queue *queue;
+
+  reset_stats();
+  starttime = get_time();
+  start_budget();
+
+  preliminary_shake(mainpicture);
+  queue = acquire_queue(ws);
+  reset_queue(queue);
+  for (i = 0; i < xpysize; i++)
+    put_into_queue(queue, i, initial_priority(mainpicture, i));
+  while (!is_queue_empty(queue) && !check_budget())
+  {
+    count_stat(STAT_LINE_SOLVES);
+    line = get_from_queue(queue);
+    if (is_line_done(mainpicture, line))
+      continue;
+    apply_line(mainpicture, queue, line, ws->testfield, solve_line(mainpicture->bits, line, ws->testfield));
+  }
+  release_queue(ws);
+  endtime = get_time();
+
+  if (!check_consistency(mainpicture->bits))
+  {
+    rc = EXIT_FAILURE;
+    solvable = "no";
+    fprintf(stderr, "Inconsistent puzzle!\n");
+  }
+  else if (mainpicture->counter == 0)
+    solvable = "yes";
+  else if (is_out_of_budget())
+  {
+    rc = EXIT_INCOMPLETE;
+    solvable = "unknown";
+    fprintf(stderr, "%s!\n", describe_budget());
+  }
+  else
+    solvable = "no";
+
+  printf("Line solvable: %s\n", solvable);
+  printf("Solved cells: %u/%u (%.1f%%)\n", vsize - mainpicture->counter, vsize,
+    100.0 * (vsize - mainpicture->counter) / vsize);
+  printf("Unknown cells: %u\n", mainpicture->counter);
+  printf("Difficulty: %.1f\n", estimate_difficulty(mainpicture));
+  printf("Processing time: %.2f sec\n", endtime-starttime);
+  if (config.stats)
+    print_stats();
+  fflush(stdout);
+  free_puzzle();
+  return rc;
+}
+
+static int solve_read_puzzle(const char *verifyfname)
+// Solve the puzzle that has been read, print the results, and free it.
+// Return the exit status.
+{
+  int rc;
+  bit *checkbits = NULL;
+  bit *second = NULL;
+  uint64_t solutions = 1;
+  bool cached;
+  const Strategy *strategy;
+  double starttime, endtime;
+#if ENABLE_DEBUG
+  unsigned int i, j;
+  char c;
+  FILE *verifyfile;
+  Picture *checkpicture = NULL;
+#endif
+
+  if (config.classify && ncolors > 0)
+  {
+    fprintf(stderr, "Colored puzzles can't be classified!\n");
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+  if (config.classify)
+    return classify_read_puzzle();
+  if (ncolors > 0)
+    return solve_color_puzzle();
+  orient_puzzle();
+  if (config.resume_file != NULL && !resume_checkpoint(config.resume_file))
+  {
+    fprintf(stderr, "No checkpoint of this puzzle in %s!\n", config.resume_file);
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+  if (config.local_search)
+    strategy = &local_strategy;
+  else
+    strategy = config.sat ? SAT_STRATEGY : config.restarts ? RESTART_STRATEGY : DEFAULT_STRATEGY;
 
 #if ENABLE_DEBUG
   if (verifyfname != NULL)
@@ -856,13 +3034,13 @@ int main(int argc, char **argv)
       checkpicture = alloc_picture();
       checkpicture->counter = 0;
       c = 0;
-      for (i = 0; i < ysize; i++)
+      for (i = 0; i < (transposed ? xsize : ysize); i++)
       {
         while (c < ' ')
           c = freadchar(verifyfile);
-        for (j = 0; j < xsize; j++)
+        for (j = 0; j < (transposed ? ysize : xsize); j++)
         {
-          checkpicture->bits[i * xsize + j] = (c == '#') ? X : O;
+          checkpicture->bits[grid_cell(i, j)] = (c == '#') ? X : O;
           freadchar(verifyfile);
           c = freadchar(verifyfile);
         }
@@ -871,22 +3049,42 @@ int main(int argc, char **argv)
       checkbits = checkpicture->bits;
     }
   }
+#else
+  (void) verifyfname;
 #endif /* ENABLE_DEBUG */
 
   rc = EXIT_SUCCESS;
 
-  fingercounter = 0;
-  
-  starttime = omp_get_wtime();
-  
-  preliminary_shake(mainpicture);
-  shake(mainpicture);
+  reset_stats();
 
-  if (!check_consistency(mainpicture->bits))
+  starttime = start_checkpoints(get_time());
+  start_budget();
+
+  cached = load_cached_solution(mainpicture);
+  if (!cached)
+  {
+    preliminary_shake(mainpicture);
+    if (config.given_file != NULL && !load_given_cells(mainpicture, config.given_file))
+    {
+      free_puzzle();
+      return EXIT_FAILURE;
+    }
+    shake(mainpicture, NULL);
+  }
+
+  if (mainpicture->counter != 0 && is_out_of_budget())
+  {
+    endtime = get_time();
+    solutions = 0;
+    if (config.checkpoint_file != NULL)
+      save_checkpoint(mainpicture, NULL);
+  }
+  else if (!check_consistency(mainpicture->bits))
   {
-    fingercounter = 0;
-    endtime = omp_get_wtime();
+    reset_stats();
+    endtime = get_time();
     rc = EXIT_FAILURE;
+    solutions = 0;
     fprintf(stderr, "Inconsistent puzzle!\n");
     if (ENABLE_DEBUG)
       print_picture(mainpicture->bits, checkbits);
@@ -903,21 +3101,200 @@ int main(int argc, char **argv)
         mainpicture->counter
       );
       printf("backtracking\n");
-      if (backtrack(mainpicture))
-        print_picture(mainpicture->bits, checkbits);
+      if (config.restarts || config.portfolio || config.local_search)
+        fprintf(stderr, "Random seed: %u\n", config.seed);
+      if (config.dimacs_file != NULL)
+        export_dimacs(mainpicture, config.dimacs_file);
+      if (config.solutions > 1)
+        second = alloc(vsize * sizeof(bit));
+      if (config.portfolio)
+        solutions = run_portfolio(mainpicture, config.solutions, second, &strategy);
       else
+        solutions = run_strategy(mainpicture, strategy, NULL, config.solutions, second);
+      if (solutions > 0)
+      {
+        print_picture(mainpicture->bits, checkbits);
+        if (solutions > 1)
+          print_picture(second, checkbits);
+      }
+      else if (!is_out_of_budget())
       {
         rc = EXIT_FAILURE;
-        fingercounter = 0;
+        reset_stats();
         fprintf(stderr, "Inconsistent puzzle!\n");
       }
+      free(second);
     }
-    endtime = omp_get_wtime();
+    endtime = get_time();
+  }
+
+  if (use_cache() && solutions == 1 && rc == EXIT_SUCCESS && !cached)
+    store_cache(config.cache_dir, mainpicture->bits);
+
+  if (solutions < config.solutions && is_out_of_budget())
+  {
+    // Give up, but show what has been found so far.
+    rc = EXIT_INCOMPLETE;
+    fprintf(stderr, "%s!\n", describe_budget());
+    if (solutions == 0)
+      print_picture(mainpicture->bits, checkbits);
+  }
+
+  if (config.solutions > 1 && (solutions > 0 || rc != EXIT_INCOMPLETE))
+  {
+    if (solutions == config.solutions || rc == EXIT_INCOMPLETE)
+      printf("Solutions: %ju or more\n", (uintmax_t) solutions);
+    else
+      printf("Solutions: %ju\n", (uintmax_t) solutions);
+    if (config.unique && solutions != 1 && rc != EXIT_INCOMPLETE)
+      rc = EXIT_FAILURE;
   }
 
   printf("Processing time: %.2f sec\n", endtime-starttime);
-  printf("%ju\n", fingercounter);
+  printf("%ju\n", get_stat(STAT_LINE_SOLVES));
+  if (config.stats)
+  {
+    print_stats();
+    printf("Strategy: %s\n", cached ? "cache" : strategy->name);
+    printf("Orientation: %s\n", transposed ? "transposed" : "as given");
+    printf("Transposition table usage: %u/%u\n", get_ttable_usage(), get_ttable_size());
+  }
+  fflush(stdout);
+#if ENABLE_DEBUG
+  free(checkpicture);
+#endif
+  free_puzzle();
+  return rc;
+}
+
+static int solve_puzzle(FILE *file, const char *verifyfname)
+// Read a puzzle, solve it, and print the results.
+// Return the exit status.
+{
+  if (!read_puzzle(file))
+  {
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+  return solve_read_puzzle(verifyfname);
+}
+
+static int solve_packed_puzzle(const Pack *pack, unsigned int index)
+// Solve a puzzle of the pack, within its own budget.
+{
+  const uint16_t *words;
+  size_t nwords;
+  int rc;
+
+  words = get_pack_puzzle(pack, index, &nwords);
+  if (nwords >= 2 && (words[0] > config.max_size || words[1] > config.max_size))
+  {
+    fprintf(stderr, "Puzzle too large for --max-size=%u: %s!\n", config.max_size, get_pack_name(pack, index));
+    return EXIT_FAILURE;
+  }
+  if (!read_packed_puzzle(words, nwords))
+  {
+    fprintf(stderr, "Corrupted puzzle in the pack: %s!\n", get_pack_name(pack, index));
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+  setup_budget(config.time_limit, config.node_limit);
+  rc = solve_read_puzzle(NULL);
+  stop_budget();
+  return rc;
+}
+
+static int solve_pack(const char *path, const char *id)
+// Solve the puzzle of the pack with this name or index or, if id is NULL,
+// every puzzle in turn.
+// Return the exit status: failure if any puzzle has failed, otherwise
+// incomplete if any has run out of its budget.
+{
+  Pack pack;
+  unsigned int i;
+  long index;
+  int rc = EXIT_SUCCESS, prc;
+
+  if (!open_pack(path, &pack))
+    return EXIT_FAILURE;
+  if (id != NULL)
+  {
+    index = find_pack_puzzle(&pack, id);
+    if (index < 0)
+    {
+      fprintf(stderr, "No such puzzle in the pack: %s!\n", id);
+      rc = EXIT_FAILURE;
+    }
+    else
+      rc = solve_packed_puzzle(&pack, index);
+  }
+  else
+  {
+    for (i = 0; i < pack.header->count; i++)
+    {
+      printf("Puzzle: %s\n", get_pack_name(&pack, i));
+      fflush(stdout);
+      prc = solve_packed_puzzle(&pack, i);
+      if (prc == EXIT_FAILURE || (prc == EXIT_INCOMPLETE && rc == EXIT_SUCCESS))
+        rc = prc;
+    }
+  }
+  close_pack(&pack);
+  return rc;
+}
+
+static int serve_puzzle(FILE *file, const RequestLimits *limits)
+// Solve a puzzle sent to the daemon.
+{
+  int rc;
+
+  setup_budget(limits->time_limit, limits->node_limit);
+  rc = solve_puzzle(file, NULL);
+  stop_budget();
+  return rc;
+}
+
+int main(int argc, char **argv)
+{
+  int rc;
+  static char *verifyfname = NULL;
+
+  setup_sigint();
+
+  parse_arguments(argc, argv, &verifyfname);
+  setup_tasks(config.threads);
+  setup_stats(get_worker_count());
+  setup_ttable(TTABLE_SIZE);
+  if (!config.seed_given)
+    config.seed = (unsigned int)(get_time() * 1e6);
+  random_seed = config.seed;
+#if ENABLE_TRACE
+  setup_trace(get_worker_count());
+#endif
 
+  if (config.daemon_socket != NULL)
+  {
+    RequestLimits limits = { config.time_limit, config.node_limit };
+    run_daemon(config.daemon_socket, config.max_clients, &limits, serve_puzzle);
+  }
+
+  if (config.checkpoint_file != NULL)
+    setup_checkpoints(config.checkpoint_interval);
+  if (config.session)
+    rc = run_session(stdin);
+  else if (config.pack_file != NULL)
+    rc = solve_pack(config.pack_file, config.pack_puzzle);
+  else
+  {
+    setup_budget(config.time_limit, config.node_limit);
+    rc = solve_puzzle(stdin, verifyfname);
+  }
+
+  shutdown_tasks();
+#if ENABLE_TRACE
+  if (config.trace_file != NULL && !dump_trace(config.trace_file))
+    perror(config.trace_file);
+#endif
   return rc;
 }
 
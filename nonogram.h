@@ -22,7 +22,15 @@
 #ifndef NONOGRAM_H
 #define NONOGRAM_H
 
-#define MAX_SIZE 999
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "queue.h"
+
+#define MAX_SIZE 999 // the default limit on the width and the height
+#define MAX_LARGE_SIZE 32767 // with --max-size; keeps the number of cells below 2^30
 #define MAX_FACTOR 10000
 #define MAX_EVIL 15.0
 
@@ -34,13 +42,88 @@ typedef signed char bit;
 typedef struct
 {
   unsigned int counter; // how many Q-fields we have
+  uint64_t hash; // Zobrist hash of the bits
   unsigned int *linecounter;
   unsigned int *evilcounter;
+  struct Trail *trail; // why the cells have been set, or NULL
   bit bits[];
 } Picture;
 
 extern unsigned int xsize, ysize, xysize, xpysize, vsize;
-extern unsigned int lmax, tmax;
+extern unsigned int lmax, tmax; // the most clues in a row and in a column, at least 1
+extern unsigned int *leftborder, *topborder;
+
+static inline size_t left_offset(unsigned int row)
+// Where the clues of a row start in leftborder (and in leftcolors).
+// Every list has room for lmax clues and a terminating 0.
+{
+  return (size_t) row * (lmax + 1);
+}
+
+static inline size_t top_offset(unsigned int column)
+{
+  return (size_t) column * (tmax + 1);
+}
+
+typedef struct
+// A part of the grid that can be searched independently of the rest
+{
+  unsigned int *cells; // unknown cells, in the order of the strategy
+  unsigned int ncells;
+  unsigned int *lines;
+  unsigned int nlines;
+  unsigned int *cell_index; // position of every cell of the grid in cells, or NO_CELL
+} Region;
+
+#define REASON_DECISION (-1)
+#define REASON_NOGOOD (-2)
+
+typedef struct
+{
+  uint64_t stamp; // when the cell was set
+  const uint64_t *nogood; // decision levels that forced the cell, for REASON_NOGOOD
+  unsigned int level; // decision level; 0 means that no decisions were involved
+  int reason; // the line that forced the cell, or REASON_*
+} CellReason;
+
+typedef struct Trail
+// How the cells of a region have been set, for conflict analysis
+{
+  const Region *region;
+  const struct Strategy *strategy;
+  struct Restart *restart; // or NULL
+  CellReason *cells; // indexed like region->cells
+  uint64_t clock;
+  unsigned int level;
+  int conflict; // a line that has no valid placement, or -1
+} Trail;
+
+static inline bool has_conflict(Picture *mpicture)
+{
+  return mpicture->trail != NULL && mpicture->trail->conflict >= 0;
+}
+
+// The solver, as used by the session (session.c) and the checkpoints (checkpoint.c)
+
+extern Picture *mainpicture;
+
+bool read_puzzle(FILE*);
+bool set_clues(unsigned int, const unsigned int*, unsigned int);
+void free_puzzle(void);
+void print_picture(bit*, bit*);
+bool check_consistency(bit*);
+
+void *alloc_picture(void);
+void duplicate_picture(Picture*, Picture*);
+void record_reasons(Picture*, const Region*);
+void forget_reasons(Picture*);
+void put_cell(Picture*, unsigned int, bit);
+void set_cell(Picture*, unsigned int, bit, int);
+
+uint64_t solve_line(bit*, unsigned int, uint64_t*);
+unsigned int apply_line(Picture*, Queue*, unsigned int, uint64_t*, uint64_t);
+bool shake(Picture*, const Region*);
+uint64_t search_picture(Picture*, uint64_t);
 
 #endif
 
@@ -0,0 +1,164 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/* Reading packs (see pack.h) through a memory mapping.
+ */
+
+#include "autoconfig.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pack.h"
+
+static bool is_valid_table(const Pack *pack, uint32_t offset, size_t size)
+{
+  return offset % sizeof(uint32_t) == 0 && offset <= pack->size && size <= pack->size - offset;
+}
+
+static bool is_valid_pack(const Pack *pack)
+// Check that every offset points into the pack,
+// so that a corrupted pack can't crash the solver.
+{
+  const PackHeader *header = pack->header;
+  const PackEntry *entry;
+  unsigned int i;
+
+  if (pack->size < sizeof(PackHeader))
+    return false;
+  if (memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) != 0 || header->size != pack->size)
+    return false;
+  if (!is_valid_table(pack, header->entries, (size_t) header->count * sizeof(PackEntry)))
+    return false;
+  if (!is_valid_table(pack, header->by_name, (size_t) header->count * sizeof(uint32_t)))
+    return false;
+  for (i = 0; i < header->count; i++)
+  {
+    entry = pack->entries + i;
+    if (entry->name >= pack->size || memchr(pack->map + entry->name, '\0', pack->size - entry->name) == NULL)
+      return false;
+    if (!is_valid_table(pack, entry->puzzle, (size_t) entry->nwords * sizeof(uint16_t)))
+      return false;
+    if (pack->by_name[i] >= header->count)
+      return false;
+  }
+  return true;
+}
+
+bool open_pack(const char *path, Pack *pack)
+// Map the pack into memory.
+// On failure, complain and return false.
+{
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0)
+  {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  if (st.st_size < (off_t) sizeof(PackHeader) || st.st_size > UINT32_MAX)
+  {
+    fprintf(stderr, "%s: not a pack\n", path);
+    close(fd);
+    return false;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    perror(path);
+    return false;
+  }
+  pack->map = map;
+  pack->size = st.st_size;
+  pack->header = map;
+  pack->entries = (const PackEntry*) (pack->map + pack->header->entries);
+  pack->by_name = (const uint32_t*) (pack->map + pack->header->by_name);
+  if (!is_valid_pack(pack))
+  {
+    fprintf(stderr, "%s: not a pack\n", path);
+    close_pack(pack);
+    return false;
+  }
+  return true;
+}
+
+void close_pack(Pack *pack)
+{
+  munmap((void*) pack->map, pack->size);
+  pack->map = NULL;
+}
+
+const char *get_pack_name(const Pack *pack, unsigned int index)
+{
+  return pack->map + pack->entries[index].name;
+}
+
+const uint16_t *get_pack_puzzle(const Pack *pack, unsigned int index, size_t *nwords)
+// Return the words of a puzzle, straight from the mapping.
+{
+  *nwords = pack->entries[index].nwords;
+  return (const uint16_t*) (pack->map + pack->entries[index].puzzle);
+}
+
+long find_pack_puzzle(const Pack *pack, const char *id)
+// Find a puzzle by its name or, failing that, by its index (from 0).
+// Return the index, or -1 if there's no such puzzle.
+{
+  unsigned int lo = 0, hi = pack->header->count, mid;
+  unsigned long index;
+  char *end;
+  int cmp;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    cmp = strcmp(id, get_pack_name(pack, pack->by_name[mid]));
+    if (cmp == 0)
+      return pack->by_name[mid];
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  if (*id < '0' || *id > '9')
+    return -1;
+  index = strtoul(id, &end, 10);
+  if (*end != '\0' || index >= pack->header->count)
+    return -1;
+  return index;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
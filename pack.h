@@ -0,0 +1,87 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/* Packs: many puzzles compiled into a single file, so that a batch of them
+ * can be loaded without parsing any text.
+ *
+ * A pack consists of:
+ *
+ *   the header,
+ *   an entry for every puzzle, in the order they were compiled,
+ *   the indices of the entries, sorted by the names of the puzzles,
+ *   the names, NUL-terminated,
+ *   the puzzles, each starting at a multiple of 4 bytes.
+ *
+ * A puzzle is a sequence of 16-bit words:
+ *
+ *   the width, the height and the number of colors (0 for black and white),
+ *   for every color, its name and its value (the high and the low word),
+ *   for every row and then every column: the number of blocks, their
+ *   lengths and, in a colored puzzle, their colors.
+ *
+ * All the numbers are in the native byte order.
+ */
+
+#ifndef NONOGRAM_PACK_H
+#define NONOGRAM_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACK_MAGIC "nonogram-pack-1" // with the NUL, 16 bytes
+
+typedef struct
+{
+  char magic[16];
+  uint32_t count; // of puzzles
+  uint32_t entries; // offset of the entries
+  uint32_t by_name; // offset of the sorted indices
+  uint32_t size; // of the whole pack
+} PackHeader;
+
+typedef struct
+{
+  uint32_t name; // offset of the name
+  uint32_t puzzle; // offset of the puzzle
+  uint32_t nwords; // size of the puzzle
+} PackEntry;
+
+typedef struct
+{
+  const char *map;
+  size_t size;
+  const PackHeader *header;
+  const PackEntry *entries;
+  const uint32_t *by_name;
+} Pack;
+
+bool open_pack(const char*, Pack*);
+void close_pack(Pack*);
+long find_pack_puzzle(const Pack*, const char*);
+const char *get_pack_name(const Pack*, unsigned int);
+const uint16_t *get_pack_puzzle(const Pack*, unsigned int, size_t*);
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -19,6 +19,8 @@
  * SOFTWARE.
  */
 
+#include "autoconfig.h"
+
 #include <assert.h>
 #include <stddef.h>
 #include <string.h>
@@ -27,6 +29,7 @@
 #include "memory.h"
 #include "nonogram.h"
 #include "queue.h"
+#include "trace.h"
 
 static inline void update_queue_enq(Queue *queue, unsigned int i)
 {
@@ -79,6 +82,13 @@ void free_queue(Queue *queue)
   free(queue);
 }
 
+void reset_queue(Queue *queue)
+// Remove all the elements, keeping the storage for reuse.
+{
+  while (queue->size > 0)
+    queue->enqueued[queue->elements[--queue->size].id] = (unsigned int)-1;
+}
+
 bool is_queue_empty(Queue *queue)
 {
   return queue->size == 0;
@@ -111,6 +121,7 @@ bool put_into_queue(Queue *queue, unsigned int id, int factor)
   queue->elements[i].id = id;
   queue->elements[i].factor = factor;
   update_queue_enq(queue, i);
+  TRACE(TRACE_QUEUE_PUT, id, -factor);
 
   return true;
 }
@@ -120,6 +131,7 @@ unsigned int get_from_queue(Queue *queue)
   unsigned int resultid, last;
   assert(queue->size > 0);
   resultid = queue->elements[0].id;
+  TRACE(TRACE_QUEUE_GET, resultid, -queue->elements[0].factor);
   last = --queue->size;
   if (queue->size > 0)
   {
@@ -131,4 +143,11 @@ unsigned int get_from_queue(Queue *queue)
   return resultid;
 }
 
+unsigned int peek_queue(Queue *queue)
+// Return the element get_from_queue() would remove, without removing it.
+{
+  assert(queue->size > 0);
+  return queue->elements[0].id;
+}
+
 /* vim:set ts=2 sts=2 sw=2 et: */
@@ -40,9 +40,11 @@ typedef struct
 
 Queue *alloc_queue(void);
 void free_queue(Queue*);
+void reset_queue(Queue*);
 bool is_queue_empty(Queue*);
 bool put_into_queue(Queue*, unsigned int, int);
 unsigned int get_from_queue(Queue*);
+unsigned int peek_queue(Queue*);
 
 #endif
 
@@ -0,0 +1,702 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* A small CDCL SAT solver.
+ *
+ * It follows the design of MiniSat (Eén and Sörensson, “An Extensible
+ * SAT-solver”, 2003): two watched literals, first-UIP clause learning with
+ * clause minimization, VSIDS branching with phase saving, and restarts
+ * following the Luby sequence. Learned clauses are periodically pruned
+ * according to their literal block distance (Audemard and Simon, “Predicting
+ * Learnt Clauses Quality in Modern SAT Solvers”, 2009).
+ */
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "budget.h"
+#include "memory.h"
+#include "sat.h"
+#include "stats.h"
+
+#define NO_CLAUSE ((unsigned int)-1)
+#define RESTART_BASE 100
+#define ACTIVITY_DECAY 0.95
+#define KEEP_LBD 2 // learned clauses with LBD up to this are never removed
+
+// Clause flags
+#define LEARNT 1
+#define DELETED 2
+
+// Internally, literal 2v is the variable v, and 2v+1 is its negation;
+// variables are numbered from 0.
+#define VAR(l) ((l) >> 1)
+#define NEG(l) ((l) ^ 1)
+
+typedef struct
+{
+  unsigned int *data;
+  unsigned int size, capacity;
+} Vector;
+
+typedef struct
+{
+  unsigned int nvars;
+  // Clauses are stored one after another: size, flags | LBD << 2, literals.
+  Vector memory;
+  unsigned int wasted;
+  Vector learnts;
+  Vector *watches; // for each literal: pairs of a clause and a blocking literal
+  signed char *values; // for each variable: 1, -1 or 0 (unassigned)
+  unsigned int *levels, *reasons;
+  bool *phases, *seen;
+  Vector trail, trail_limits;
+  unsigned int head; // trail position of the next literal to propagate
+  double *activities, increment;
+  unsigned int *heap, *heap_index, heap_size;
+  unsigned int *level_stamps, stamp;
+  Vector learnt, minimized;
+} Solver;
+
+static void push(Vector *vector, unsigned int value)
+{
+  if (vector->size == vector->capacity)
+  {
+    vector->capacity = vector->capacity > 0 ? 2 * vector->capacity : 8;
+    vector->data = resize(vector->data, vector->capacity * sizeof(unsigned int));
+  }
+  vector->data[vector->size++] = value;
+}
+
+Cnf *alloc_cnf(void)
+{
+  return alloc(sizeof(Cnf));
+}
+
+void free_cnf(Cnf *cnf)
+{
+  free(cnf->literals);
+  free(cnf);
+}
+
+unsigned int new_variable(Cnf *cnf)
+{
+  return ++cnf->nvars;
+}
+
+void add_clause(Cnf *cnf, const int *literals, unsigned int n)
+{
+  unsigned int i;
+  if (cnf->size + n + 1 > cnf->capacity)
+  {
+    cnf->capacity = 2 * (cnf->size + n + 1);
+    cnf->literals = resize(cnf->literals, cnf->capacity * sizeof(int));
+  }
+  for (i = 0; i < n; i++)
+  {
+    assert(literals[i] != 0 && (unsigned int)abs(literals[i]) <= cnf->nvars);
+    cnf->literals[cnf->size++] = literals[i];
+  }
+  cnf->literals[cnf->size++] = 0;
+  cnf->nclauses++;
+}
+
+bool write_dimacs(const Cnf *cnf, FILE *file)
+{
+  size_t i;
+  fprintf(file, "p cnf %u %u\n", cnf->nvars, cnf->nclauses);
+  for (i = 0; i < cnf->size; i++)
+    fprintf(file, cnf->literals[i] == 0 ? "0\n" : "%d ", cnf->literals[i]);
+  return !ferror(file);
+}
+
+static inline int value_of(Solver *solver, unsigned int literal)
+{
+  int value = solver->values[VAR(literal)];
+  return literal & 1 ? -value : value;
+}
+
+static inline unsigned int *clause_literals(Solver *solver, unsigned int clause)
+{
+  return solver->memory.data + clause + 2;
+}
+
+static inline unsigned int clause_size(Solver *solver, unsigned int clause)
+{
+  return solver->memory.data[clause];
+}
+
+static inline unsigned int decision_level(Solver *solver)
+{
+  return solver->trail_limits.size;
+}
+
+static void heap_up(Solver *solver, unsigned int i)
+{
+  unsigned int var = solver->heap[i], parent;
+  while (i > 0 && solver->activities[solver->heap[parent = (i - 1) / 2]] < solver->activities[var])
+  {
+    solver->heap[i] = solver->heap[parent];
+    solver->heap_index[solver->heap[i]] = i;
+    i = parent;
+  }
+  solver->heap[i] = var;
+  solver->heap_index[var] = i;
+}
+
+static void heap_down(Solver *solver, unsigned int i)
+{
+  unsigned int var = solver->heap[i], child;
+  while ((child = 2 * i + 1) < solver->heap_size)
+  {
+    if (child + 1 < solver->heap_size && solver->activities[solver->heap[child + 1]] > solver->activities[solver->heap[child]])
+      child++;
+    if (solver->activities[solver->heap[child]] <= solver->activities[var])
+      break;
+    solver->heap[i] = solver->heap[child];
+    solver->heap_index[solver->heap[i]] = i;
+    i = child;
+  }
+  solver->heap[i] = var;
+  solver->heap_index[var] = i;
+}
+
+static void heap_insert(Solver *solver, unsigned int var)
+{
+  if (solver->heap_index[var] != NO_CLAUSE)
+    return;
+  solver->heap[solver->heap_size] = var;
+  heap_up(solver, solver->heap_size++);
+}
+
+static unsigned int heap_pop(Solver *solver)
+{
+  unsigned int var = solver->heap[0];
+  solver->heap_index[var] = NO_CLAUSE;
+  if (--solver->heap_size > 0)
+  {
+    solver->heap[0] = solver->heap[solver->heap_size];
+    heap_down(solver, 0);
+  }
+  return var;
+}
+
+static void bump_variable(Solver *solver, unsigned int var)
+{
+  unsigned int i;
+  if ((solver->activities[var] += solver->increment) > 1e100)
+  {
+    for (i = 0; i < solver->nvars; i++)
+      solver->activities[i] *= 1e-100;
+    solver->increment *= 1e-100;
+  }
+  if (solver->heap_index[var] != NO_CLAUSE)
+    heap_up(solver, solver->heap_index[var]);
+}
+
+static void enqueue(Solver *solver, unsigned int literal, unsigned int reason)
+{
+  unsigned int var = VAR(literal);
+  assert(solver->values[var] == 0);
+  solver->values[var] = literal & 1 ? -1 : 1;
+  solver->levels[var] = decision_level(solver);
+  solver->reasons[var] = reason;
+  push(&solver->trail, literal);
+}
+
+static void watch_clause(Solver *solver, unsigned int clause)
+{
+  unsigned int *literals = clause_literals(solver, clause);
+  push(&solver->watches[literals[0]], clause);
+  push(&solver->watches[literals[0]], literals[1]);
+  push(&solver->watches[literals[1]], clause);
+  push(&solver->watches[literals[1]], literals[0]);
+}
+
+static unsigned int store_clause(Solver *solver, const unsigned int *literals, unsigned int size, unsigned int flags)
+{
+  unsigned int i, clause = solver->memory.size;
+  push(&solver->memory, size);
+  push(&solver->memory, flags);
+  for (i = 0; i < size; i++)
+    push(&solver->memory, literals[i]);
+  return clause;
+}
+
+static unsigned int propagate(Solver *solver)
+// Return the conflicting clause, or NO_CLAUSE.
+{
+  unsigned int false_literal, clause, blocker, first, size, i, j, k;
+  unsigned int *literals;
+  Vector *watches;
+
+  while (solver->head < solver->trail.size)
+  {
+    false_literal = NEG(solver->trail.data[solver->head++]);
+    watches = &solver->watches[false_literal];
+    for (i = j = 0; i < watches->size; )
+    {
+      clause = watches->data[i++];
+      blocker = watches->data[i++];
+      if (value_of(solver, blocker) > 0)
+      {
+        watches->data[j++] = clause;
+        watches->data[j++] = blocker;
+        continue;
+      }
+      if (solver->memory.data[clause + 1] & DELETED)
+        continue;
+      literals = clause_literals(solver, clause);
+      if (literals[0] == false_literal)
+      {
+        literals[0] = literals[1];
+        literals[1] = false_literal;
+      }
+      first = literals[0];
+      if (first != blocker && value_of(solver, first) > 0)
+      {
+        watches->data[j++] = clause;
+        watches->data[j++] = first;
+        continue;
+      }
+      size = clause_size(solver, clause);
+      for (k = 2; k < size; k++)
+      if (value_of(solver, literals[k]) >= 0)
+      {
+        literals[1] = literals[k];
+        literals[k] = false_literal;
+        push(&solver->watches[literals[1]], clause);
+        push(&solver->watches[literals[1]], first);
+        break;
+      }
+      if (k < size)
+        continue;
+      watches->data[j++] = clause;
+      watches->data[j++] = first;
+      if (value_of(solver, first) < 0)
+      {
+        while (i < watches->size)
+          watches->data[j++] = watches->data[i++];
+        watches->size = j;
+        solver->head = solver->trail.size;
+        return clause;
+      }
+      enqueue(solver, first, clause);
+    }
+    watches->size = j;
+  }
+  return NO_CLAUSE;
+}
+
+static bool is_redundant(Solver *solver, unsigned int literal)
+// Is the literal implied by the other literals of the learned clause?
+{
+  unsigned int i, var, reason = solver->reasons[VAR(literal)];
+  unsigned int *literals;
+
+  if (reason == NO_CLAUSE)
+    return false;
+  literals = clause_literals(solver, reason);
+  for (i = 1; i < clause_size(solver, reason); i++)
+  {
+    var = VAR(literals[i]);
+    if (!solver->seen[var] && solver->levels[var] > 0)
+      return false;
+  }
+  return true;
+}
+
+static unsigned int analyze(Solver *solver, unsigned int clause)
+// Derive the first-UIP clause from the conflict into solver->learnt,
+// with the asserting literal first.
+// Return the level to jump back to.
+{
+  unsigned int pending = 0, literal = NO_CLAUSE, index = solver->trail.size;
+  unsigned int i, j, var, size, level, *literals;
+  Vector *learnt = &solver->learnt;
+
+  learnt->size = 0;
+  push(learnt, 0); // placeholder for the asserting literal
+  do
+  {
+    literals = clause_literals(solver, clause);
+    size = clause_size(solver, clause);
+    for (i = (literal == NO_CLAUSE ? 0 : 1); i < size; i++)
+    {
+      var = VAR(literals[i]);
+      if (solver->seen[var] || solver->levels[var] == 0)
+        continue;
+      bump_variable(solver, var);
+      solver->seen[var] = true;
+      if (solver->levels[var] >= decision_level(solver))
+        pending++;
+      else
+        push(learnt, literals[i]);
+    }
+    do
+      literal = solver->trail.data[--index];
+    while (!solver->seen[VAR(literal)]);
+    clause = solver->reasons[VAR(literal)];
+    solver->seen[VAR(literal)] = false;
+  }
+  while (--pending > 0);
+  learnt->data[0] = NEG(literal);
+
+  // Drop the literals implied by the others.
+  solver->minimized.size = 0;
+  for (i = j = 1; i < learnt->size; i++)
+  {
+    push(&solver->minimized, learnt->data[i]);
+    if (!is_redundant(solver, learnt->data[i]))
+      learnt->data[j++] = learnt->data[i];
+  }
+  learnt->size = j;
+  for (i = 0; i < solver->minimized.size; i++)
+    solver->seen[VAR(solver->minimized.data[i])] = false;
+
+  // Put a literal of the highest remaining level second, so that it's watched.
+  level = 0;
+  for (i = 1, j = 1; i < learnt->size; i++)
+  if (solver->levels[VAR(learnt->data[i])] > level)
+  {
+    level = solver->levels[VAR(learnt->data[i])];
+    j = i;
+  }
+  if (learnt->size > 1)
+  {
+    literal = learnt->data[1];
+    learnt->data[1] = learnt->data[j];
+    learnt->data[j] = literal;
+  }
+  return level;
+}
+
+static unsigned int compute_lbd(Solver *solver, const unsigned int *literals, unsigned int size)
+// Count the distinct decision levels of the literals.
+{
+  unsigned int i, level, lbd = 0;
+  solver->stamp++;
+  for (i = 0; i < size; i++)
+  {
+    level = solver->levels[VAR(literals[i])];
+    if (solver->level_stamps[level] != solver->stamp)
+    {
+      solver->level_stamps[level] = solver->stamp;
+      lbd++;
+    }
+  }
+  return lbd;
+}
+
+static void backjump(Solver *solver, unsigned int level)
+{
+  unsigned int i, var;
+  if (decision_level(solver) <= level)
+    return;
+  for (i = solver->trail.size; i > solver->trail_limits.data[level]; i--)
+  {
+    var = VAR(solver->trail.data[i - 1]);
+    solver->phases[var] = solver->values[var] > 0;
+    solver->values[var] = 0;
+    solver->reasons[var] = NO_CLAUSE;
+    heap_insert(solver, var);
+  }
+  solver->trail.size = solver->head = solver->trail_limits.data[level];
+  solver->trail_limits.size = level;
+}
+
+static bool is_locked(Solver *solver, unsigned int clause)
+{
+  unsigned int literal = clause_literals(solver, clause)[0];
+  return value_of(solver, literal) > 0 && solver->reasons[VAR(literal)] == clause;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x < y) - (x > y);
+}
+
+static void collect_garbage(Solver *solver)
+// Compact the clause memory, dropping the deleted clauses.
+{
+  Vector memory = { NULL, 0, 0 };
+  unsigned int i, clause, size, flags, var;
+
+  for (i = 0; i < 2 * solver->nvars; i++)
+    solver->watches[i].size = 0;
+  solver->learnts.size = 0;
+  for (clause = 0; clause < solver->memory.size; clause += size + 2)
+  {
+    size = solver->memory.data[clause];
+    flags = solver->memory.data[clause + 1];
+    if (flags & DELETED)
+      continue;
+    // Leave a forwarding address for the reasons.
+    solver->memory.data[clause + 1] = memory.size;
+    push(&memory, size);
+    push(&memory, flags);
+    for (i = 0; i < size; i++)
+      push(&memory, solver->memory.data[clause + 2 + i]);
+    if (flags & LEARNT)
+      push(&solver->learnts, memory.size - size - 2);
+  }
+  for (i = 0; i < solver->trail.size; i++)
+  {
+    var = VAR(solver->trail.data[i]);
+    if (solver->reasons[var] != NO_CLAUSE)
+      solver->reasons[var] = solver->memory.data[solver->reasons[var] + 1];
+  }
+  free(solver->memory.data);
+  solver->memory = memory;
+  solver->wasted = 0;
+  for (clause = 0; clause < solver->memory.size; clause += solver->memory.data[clause] + 2)
+    watch_clause(solver, clause);
+}
+
+static void reduce_learnts(Solver *solver)
+// Remove the worse half of the learned clauses.
+{
+  unsigned int i, clause, count = solver->learnts.size / 2;
+  uint64_t *keys = alloc(solver->learnts.size * sizeof(uint64_t));
+
+  // Sort by LBD, worst first.
+  for (i = 0; i < solver->learnts.size; i++)
+  {
+    clause = solver->learnts.data[i];
+    keys[i] = (uint64_t)(solver->memory.data[clause + 1] >> 2) << 32 | clause;
+  }
+  qsort(keys, solver->learnts.size, sizeof(uint64_t), compare_keys);
+  for (i = 0; i < count; i++)
+  {
+    clause = (unsigned int)keys[i];
+    if ((solver->memory.data[clause + 1] >> 2) <= KEEP_LBD || is_locked(solver, clause))
+      continue;
+    solver->memory.data[clause + 1] |= DELETED;
+    solver->wasted += clause_size(solver, clause) + 2;
+  }
+  free(keys);
+  if (2 * solver->wasted > solver->memory.size)
+    collect_garbage(solver);
+  else
+  {
+    for (i = 0; i < solver->learnts.size; )
+    if (solver->memory.data[solver->learnts.data[i] + 1] & DELETED)
+      solver->learnts.data[i] = solver->learnts.data[--solver->learnts.size];
+    else
+      i++;
+  }
+}
+
+unsigned int luby(unsigned int i)
+// The i-th element (counting from 0) of the Luby sequence: 1 1 2 1 1 2 4 ...
+{
+  unsigned int size, power;
+  for (size = 1, power = 0; size < i + 1; power++)
+    size = 2 * size + 1;
+  while (size - 1 != i)
+  {
+    size = (size - 1) / 2;
+    power--;
+    i %= size;
+  }
+  return 1U << power;
+}
+
+static bool load_clauses(Solver *solver, const Cnf *cnf)
+// Return false if the formula is trivially unsatisfiable.
+{
+  unsigned int i, k, literal;
+  size_t n;
+  bool tautology, res;
+  Vector units = { NULL, 0, 0 };
+
+  for (n = 0; n < cnf->size; n++)
+  {
+    solver->learnt.size = 0;
+    tautology = false;
+    for (; cnf->literals[n] != 0; n++)
+    {
+      literal = 2 * (abs(cnf->literals[n]) - 1) + (cnf->literals[n] < 0);
+      for (k = 0; k < solver->learnt.size; k++)
+      {
+        if (solver->learnt.data[k] == NEG(literal))
+          tautology = true;
+        if (solver->learnt.data[k] == literal)
+          break;
+      }
+      if (k == solver->learnt.size)
+        push(&solver->learnt, literal);
+    }
+    if (tautology)
+      continue;
+    switch (solver->learnt.size)
+    {
+    case 0:
+      free(units.data);
+      return false;
+    case 1:
+      push(&units, solver->learnt.data[0]);
+      break;
+    default:
+      watch_clause(solver, store_clause(solver, solver->learnt.data, solver->learnt.size, 0));
+    }
+  }
+  res = true;
+  for (i = 0; i < units.size && res; i++)
+  {
+    literal = units.data[i];
+    if (value_of(solver, literal) < 0)
+      res = false;
+    else if (value_of(solver, literal) == 0)
+      enqueue(solver, literal, NO_CLAUSE);
+  }
+  free(units.data);
+  return res && propagate(solver) == NO_CLAUSE;
+}
+
+static Solver *alloc_solver(unsigned int nvars)
+{
+  unsigned int i;
+  Solver *solver = alloc(sizeof(Solver));
+
+  solver->nvars = nvars;
+  solver->watches = alloc(2 * nvars * sizeof(Vector));
+  solver->values = alloc(nvars);
+  solver->levels = alloc(nvars * sizeof(unsigned int));
+  solver->reasons = alloc(nvars * sizeof(unsigned int));
+  solver->phases = alloc(nvars * sizeof(bool));
+  solver->seen = alloc(nvars * sizeof(bool));
+  solver->activities = alloc(nvars * sizeof(double));
+  solver->heap = alloc(nvars * sizeof(unsigned int));
+  solver->heap_index = alloc(nvars * sizeof(unsigned int));
+  solver->level_stamps = alloc((nvars + 1) * sizeof(unsigned int));
+  solver->increment = 1.0;
+  for (i = 0; i < nvars; i++)
+  {
+    solver->reasons[i] = NO_CLAUSE;
+    solver->heap_index[i] = NO_CLAUSE;
+    heap_insert(solver, i);
+  }
+  return solver;
+}
+
+static void free_solver(Solver *solver)
+{
+  unsigned int i;
+  for (i = 0; i < 2 * solver->nvars; i++)
+    free(solver->watches[i].data);
+  free(solver->watches);
+  free(solver->memory.data);
+  free(solver->learnts.data);
+  free(solver->trail.data);
+  free(solver->trail_limits.data);
+  free(solver->learnt.data);
+  free(solver->minimized.data);
+  free(solver->values);
+  free(solver->levels);
+  free(solver->reasons);
+  free(solver->phases);
+  free(solver->seen);
+  free(solver->activities);
+  free(solver->heap);
+  free(solver->heap_index);
+  free(solver->level_stamps);
+  free(solver);
+}
+
+static bool search(Solver *solver, const atomic_bool *stop)
+{
+  unsigned int clause, level, var, restarts = 0, conflicts = 0;
+  unsigned int max_learnts = solver->memory.size / 8 + 1000;
+
+  while (true)
+  {
+    clause = propagate(solver);
+    if (clause != NO_CLAUSE)
+    {
+      count_stat(STAT_SAT_CONFLICTS);
+      conflicts++;
+      if (decision_level(solver) == 0 || check_budget())
+        return false;
+      if (stop != NULL && atomic_load_explicit(stop, memory_order_relaxed))
+        return false;
+      level = analyze(solver, clause);
+      backjump(solver, level);
+      if (solver->learnt.size == 1)
+        enqueue(solver, solver->learnt.data[0], NO_CLAUSE);
+      else
+      {
+        clause = store_clause(solver, solver->learnt.data, solver->learnt.size,
+          LEARNT | compute_lbd(solver, solver->learnt.data, solver->learnt.size) << 2);
+        push(&solver->learnts, clause);
+        watch_clause(solver, clause);
+        enqueue(solver, solver->learnt.data[0], clause);
+      }
+      solver->increment /= ACTIVITY_DECAY;
+      continue;
+    }
+    if (conflicts >= RESTART_BASE * luby(restarts))
+    {
+      backjump(solver, 0);
+      restarts++;
+      conflicts = 0;
+    }
+    if (solver->learnts.size >= max_learnts)
+    {
+      reduce_learnts(solver);
+      max_learnts += max_learnts / 10;
+    }
+    do
+    {
+      if (solver->heap_size == 0)
+        return true;
+      var = heap_pop(solver);
+    }
+    while (solver->values[var] != 0);
+    count_stat(STAT_SAT_DECISIONS);
+    push(&solver->trail_limits, solver->trail.size);
+    enqueue(solver, 2 * var + !solver->phases[var], NO_CLAUSE);
+  }
+}
+
+bool solve_cnf(const Cnf *cnf, bool *model, const atomic_bool *stop)
+// On success, model[v] is the value of the variable v.
+// Fail also if the budget runs out, or if *stop becomes true.
+{
+  unsigned int i;
+  bool res;
+  Solver *solver = alloc_solver(cnf->nvars);
+
+  res = load_clauses(solver, cnf) && search(solver, stop);
+  if (res)
+  for (i = 0; i < cnf->nvars; i++)
+    model[i + 1] = solver->values[i] > 0;
+  free_solver(solver);
+  return res;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
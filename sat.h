@@ -0,0 +1,49 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NONOGRAM_SAT_H
+#define NONOGRAM_SAT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct
+// A formula in conjunctive normal form.
+// Literals are numbered as in DIMACS: v or -v, for a variable v > 0.
+{
+  unsigned int nvars, nclauses;
+  int *literals; // the clauses, each terminated by 0
+  size_t size, capacity;
+} Cnf;
+
+Cnf *alloc_cnf(void);
+void free_cnf(Cnf*);
+unsigned int new_variable(Cnf*);
+void add_clause(Cnf*, const int*, unsigned int);
+bool write_dimacs(const Cnf*, FILE*);
+bool solve_cnf(const Cnf*, bool*, const atomic_bool*);
+unsigned int luby(unsigned int);
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,456 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* An interactive session (--session): after every change of the clues, the
+ * puzzle is solved again, starting from what still holds of the last time.
+ */
+
+#include "autoconfig.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "budget.h"
+#include "color.h"
+#include "config.h"
+#include "memory.h"
+#include "nonogram.h"
+#include "queue.h"
+#include "session.h"
+#include "timer.h"
+#include "ttable.h"
+
+#define NO_CELL ((unsigned int)-1)
+
+#define MAX_COMMAND 4096 // length of a command line
+
+typedef struct
+// An interactive session: the line-solved picture keeps the reason for every
+// known cell, so that changing a clue undoes only what depended on it.
+{
+  Region whole;
+  Trail *trail;
+  Queue *queue; // for the crossing lines of the lines solved again
+  uint64_t *testfield;
+  bool settled; // line solving has run to completion
+  unsigned int *order; // known cells by stamp
+  int *reasons; // the lines that set them
+  bit *old; // the picture before the clues changed
+  unsigned int *mark; // for every cell, the deduction that set it last time
+  bool *diverged; // for every line
+  bit *before; // scratch for a line
+  unsigned int *lines; // to be solved again (room for each line twice)
+  unsigned int *clues;
+  bit *shown; // the grid of the last answer
+  const char *status;
+} Session;
+
+static void setup_session(Session *session)
+{
+  unsigned int i;
+
+  session->whole.cells = alloc(vsize * sizeof(unsigned int));
+  session->whole.cell_index = alloc(vsize * sizeof(unsigned int));
+  session->whole.lines = alloc(xpysize * sizeof(unsigned int));
+  session->whole.ncells = vsize;
+  session->whole.nlines = xpysize;
+  for (i = 0; i < vsize; i++)
+    session->whole.cells[i] = session->whole.cell_index[i] = i;
+  for (i = 0; i < xpysize; i++)
+    session->whole.lines[i] = i;
+
+  record_reasons(mainpicture, &session->whole);
+  session->trail = mainpicture->trail;
+  session->queue = alloc_queue();
+  session->testfield = alloc(xysize * sizeof(uint64_t));
+
+  session->settled = false;
+  session->order = alloc(vsize * sizeof(unsigned int));
+  session->reasons = alloc(vsize * sizeof(int));
+  session->old = alloc(vsize * sizeof(bit));
+  session->mark = alloc(vsize * sizeof(unsigned int));
+  session->diverged = alloc(xpysize * sizeof(bool));
+  session->before = alloc(xysize * sizeof(bit));
+  session->lines = alloc(2 * xpysize * sizeof(unsigned int));
+  session->clues = alloc(xysize * sizeof(unsigned int));
+  session->shown = alloc(vsize * sizeof(bit));
+  session->status = NULL;
+}
+
+static void free_session(Session *session)
+{
+  forget_reasons(mainpicture);
+  free(session->whole.cells);
+  free(session->whole.cell_index);
+  free(session->whole.lines);
+  free_queue(session->queue);
+  free(session->testfield);
+  free(session->order);
+  free(session->reasons);
+  free(session->old);
+  free(session->mark);
+  free(session->diverged);
+  free(session->before);
+  free(session->lines);
+  free(session->clues);
+  free(session->shown);
+}
+
+static inline void clear_cell(Picture *mpicture, unsigned int n)
+{
+  mpicture->hash ^= zobrist_key(n, mpicture->bits[n]);
+  mpicture->bits[n] = Q;
+  mpicture->counter++;
+  mpicture->linecounter[n / xsize]++;
+  mpicture->linecounter[ysize + n % xsize]++;
+}
+
+static uint64_t overlap_line(unsigned int line, uint64_t *testfield)
+// Like preliminary_shake(), for a single line: the cells that every block
+// covers both when all of them are pushed left and when pushed right.
+// Fill the testfield so that apply_line() sets just these cells, and return
+// the matching count.
+{
+  unsigned int i, j, size, left, right, *border;
+
+  if (line < ysize)
+    border = leftborder + left_offset(line), size = xsize;
+  else
+    border = topborder + top_offset(line - ysize), size = ysize;
+  if (border[0] == 0)
+  {
+    memset(testfield, 0, size * sizeof(uint64_t));
+    return 1;
+  }
+  for (i = 0; i < size; i++)
+    testfield[i] = 1;
+  right = size + 1;
+  for (j = 0; j < size && border[j] > 0; j++)
+    right -= border[j] + 1;
+  left = 0;
+  for (j = 0; j < size && border[j] > 0; j++)
+  {
+    // The block starts somewhere between left and right.
+    for (i = right; i < left + border[j]; i++)
+      testfield[i] = 2;
+    left += border[j] + 1;
+    right += border[j] + 1;
+  }
+  return 2;
+}
+
+static void redo_line(Session *session, unsigned int line, unsigned int first, unsigned int last)
+// Solve the line again, in place of the deduction that set the cells
+// order[first..last). The crossing lines of the cells that come out
+// differently diverge.
+{
+  Queue *queue = session->queue;
+  unsigned int i, n, size, start, mul;
+  uint64_t count;
+
+  if (line < ysize)
+    size = xsize, start = line * xsize, mul = 1;
+  else
+    size = ysize, start = line - ysize, mul = xsize;
+  for (i = 0; i < size; i++)
+    session->before[i] = mainpicture->bits[start + i * mul];
+
+  reset_queue(queue);
+  if (mainpicture->linecounter[line] == size)
+    count = overlap_line(line, session->testfield);
+  else
+    count = solve_line(mainpicture->bits, line, session->testfield);
+  apply_line(mainpicture, queue, line, session->testfield, count);
+
+  for (i = first; i < last; i++)
+  {
+    n = session->order[i];
+    session->mark[n] = first;
+    if (mainpicture->bits[n] != session->old[n])
+      session->diverged[line < ysize ? ysize + n % xsize : n / xsize] = true;
+  }
+  for (i = 0; i < size; i++)
+  {
+    n = start + i * mul;
+    if (mainpicture->bits[n] != session->before[i] && session->mark[n] != first)
+      session->diverged[line < ysize ? ysize + n % xsize : n / xsize] = true;
+  }
+}
+
+static unsigned int replay_history(Session *session, unsigned int line)
+// Line solving is replayed from a blank grid, in the order in which the cells
+// have been set. A deduction is redone only if its line has diverged: if its
+// clues or its cells at that point may differ from the last time. Otherwise,
+// the same cells are just set again.
+// Return the number of diverged lines, which are put in lines.
+{
+  Trail *trail = session->trail;
+  unsigned int i, j, n, nlines, known = trail->clock;
+  int reason;
+
+  for (n = 0; n < vsize; n++)
+  {
+    session->old[n] = mainpicture->bits[n];
+    if (mainpicture->bits[n] != Q)
+      session->order[trail->cells[n].stamp] = n;
+  }
+  for (i = 0; i < known; i++)
+    session->reasons[i] = trail->cells[session->order[i]].reason;
+  for (n = 0; n < vsize; n++)
+  {
+    session->mark[n] = NO_CELL;
+    if (mainpicture->bits[n] != Q)
+      clear_cell(mainpicture, n);
+  }
+  for (i = 0; i < xpysize; i++)
+    session->diverged[i] = false;
+  session->diverged[line] = true;
+  trail->clock = 0;
+  trail->conflict = -1;
+
+  for (i = 0; i < known && !has_conflict(mainpicture); i = j)
+  {
+    reason = session->reasons[i];
+    for (j = i; j < known && session->reasons[j] == reason; j++)
+      ;
+    if (session->diverged[reason])
+      redo_line(session, reason, i, j);
+    else
+      for (; i < j; i++)
+      {
+        n = session->order[i];
+        assert(mainpicture->bits[n] == Q);
+        set_cell(mainpicture, n, session->old[n], reason);
+      }
+  }
+
+  nlines = 0;
+  for (i = 0; i < xpysize; i++)
+    if (session->diverged[i])
+      session->lines[nlines++] = i;
+  return nlines;
+}
+
+static void answer_session(Session *session, bit *bits, double starttime)
+// Print the grid, the cells that have changed since the last answer,
+// and whether the solution is unique.
+{
+  unsigned int n, changed = 0;
+
+  print_picture(bits, NULL);
+  for (n = 0; n < vsize; n++)
+    changed += bits[n] != session->shown[n];
+  printf("Changed cells: %u\n", changed);
+  for (n = 0; n < vsize; n++)
+    if (bits[n] != session->shown[n])
+      printf("%u %u %c\n", n / xsize + 1, n % xsize + 1, bits[n] == X ? '#' : bits[n] == O ? '.' : '?');
+  memcpy(session->shown, bits, vsize * sizeof(bit));
+  printf("Status: %s\n", session->status);
+  printf("Processing time: %.2f ms\n", (get_time() - starttime) * 1000.0);
+  fflush(stdout);
+}
+
+static unsigned int solve_blank_lines(Session *session, unsigned int nlines)
+// finger_line() skips the lines with no known cells, leaving them to
+// preliminary_shake(). Solve them here instead, so that the cells they force
+// get reasons, and add the crossing lines that got new cells.
+// Return the new number of lines.
+{
+  Queue *queue = session->queue;
+  unsigned int i, line, size;
+
+  reset_queue(queue);
+  for (i = 0; i < nlines; i++)
+  {
+    line = session->lines[i];
+    size = line < ysize ? xsize : ysize;
+    if (mainpicture->linecounter[line] == size)
+      apply_line(mainpicture, queue, line, session->testfield, overlap_line(line, session->testfield));
+  }
+  while (!is_queue_empty(queue))
+    session->lines[nlines++] = get_from_queue(queue);
+  return nlines;
+}
+
+static void update_session(Session *session, unsigned int nlines, double starttime)
+// Line-solve the lines in session->lines, search for up to two solutions,
+// and answer.
+{
+  Region dirty = session->whole;
+  Picture *work;
+  uint64_t count;
+
+  setup_budget(config.time_limit, config.node_limit);
+  start_budget();
+  dirty.lines = session->lines;
+  dirty.nlines = solve_blank_lines(session, nlines);
+  if (!has_conflict(mainpicture))
+    shake(mainpicture, &dirty);
+  session->settled = !has_conflict(mainpicture) && !is_out_of_budget();
+
+  work = NULL;
+  if (has_conflict(mainpicture))
+    session->status = "inconsistent";
+  else if (is_out_of_budget())
+    session->status = "unknown";
+  else if (mainpicture->counter == 0)
+    session->status = check_consistency(mainpicture->bits) ? "unique" : "inconsistent";
+  else
+  {
+    work = alloc_picture();
+    duplicate_picture(mainpicture, work);
+    count = search_picture(work, 2);
+    if (count > 0)
+      session->status = count == 1 ? "unique" : "multiple";
+    else
+    {
+      session->status = is_out_of_budget() ? "unknown" : "inconsistent";
+      free(work);
+      work = NULL;
+    }
+  }
+  stop_budget();
+  answer_session(session, work != NULL ? work->bits : mainpicture->bits, starttime);
+  free(work);
+}
+
+static bool parse_clues(unsigned int *clues, unsigned int *nclues, unsigned int max)
+// Parse the rest of the command being split by strtok().
+{
+  char *word, *end;
+  unsigned long k;
+
+  *nclues = 0;
+  while ((word = strtok(NULL, " \t\r\n")) != NULL)
+  {
+    k = strtoul(word, &end, 10);
+    if (*end != '\0' || *word == '-' || k > config.max_size || *nclues == max)
+      return false;
+    clues[(*nclues)++] = k;
+  }
+  return true;
+}
+
+static unsigned int list_all_lines(Session *session)
+{
+  unsigned int i;
+  for (i = 0; i < xpysize; i++)
+    session->lines[i] = i;
+  return xpysize;
+}
+
+int run_session(FILE *file)
+// Solve a puzzle, and then keep solving it again as commands change its
+// clues:
+//   row N CLUES...
+//   column N CLUES...
+//   show
+//   quit
+{
+  Session session;
+  char command[MAX_COMMAND];
+  char *word, *end;
+  unsigned long index;
+  unsigned int line, nlines, nclues;
+  double starttime;
+  bool valid;
+
+  if (!read_puzzle(file))
+  {
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+  if (ncolors > 0)
+  {
+    fprintf(stderr, "Colored puzzles can't be edited in a session!\n");
+    free_puzzle();
+    return EXIT_FAILURE;
+  }
+  setup_session(&session);
+  starttime = get_time();
+  update_session(&session, list_all_lines(&session), starttime);
+
+  while (fgets(command, sizeof(command), file) != NULL)
+  {
+    starttime = get_time();
+    if (strchr(command, '\n') == NULL && !feof(file))
+    {
+      while (fgets(command, sizeof(command), file) != NULL && strchr(command, '\n') == NULL)
+        ;
+      printf("Error: line too long\n");
+      fflush(stdout);
+      continue;
+    }
+    word = strtok(command, " \t\r\n");
+    if (word == NULL)
+      continue;
+    if (strcmp(word, "quit") == 0)
+      break;
+    if (strcmp(word, "show") == 0)
+    {
+      answer_session(&session, session.shown, starttime);
+      continue;
+    }
+    valid = false;
+    if (strcmp(word, "row") == 0 || strcmp(word, "column") == 0)
+    {
+      line = word[0] == 'r' ? 0 : ysize;
+      word = strtok(NULL, " \t\r\n");
+      if (word != NULL)
+      {
+        index = strtoul(word, &end, 10);
+        valid = *end == '\0' && *word != '-' && index >= 1 && index <= (line == 0 ? ysize : xsize);
+        line += index - 1;
+      }
+      valid = valid && parse_clues(session.clues, &nclues, xysize);
+      valid = valid && set_clues(line, session.clues, nclues);
+    }
+    else
+    {
+      printf("Error: unknown command\n");
+      fflush(stdout);
+      continue;
+    }
+    if (!valid)
+    {
+      printf("Error: invalid clues\n");
+      fflush(stdout);
+      continue;
+    }
+    // Refuted pictures may have solutions under the new clues.
+    clear_ttable();
+    nlines = replay_history(&session, line);
+    // Line solving that hasn't run to completion has left lines to be done.
+    if (!session.settled)
+      nlines = list_all_lines(&session);
+    update_session(&session, nlines, starttime);
+  }
+
+  free_session(&session);
+  free_puzzle();
+  return EXIT_SUCCESS;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
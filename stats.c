@@ -0,0 +1,81 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "stats.h"
+
+StatBlock *stat_blocks;
+static unsigned int stat_block_count;
+
+static const char *stat_names[STAT_COUNT] = {
+  [STAT_LINE_SOLVES] = "Line solves",
+  [STAT_SHAKES] = "Shakes",
+  [STAT_NODES] = "Search nodes",
+  [STAT_SPLITS] = "Parallel splits",
+  [STAT_REGIONS] = "Independent regions",
+  [STAT_TT_PROBES] = "Transposition table probes",
+  [STAT_TT_HITS] = "Transposition table hits",
+  [STAT_TT_STORES] = "Transposition table stores",
+  [STAT_NOGOODS] = "Learned nogoods",
+  [STAT_BACKJUMPS] = "Backjumps",
+  [STAT_RESTARTS] = "Restarts",
+  [STAT_SAT_DECISIONS] = "SAT decisions",
+  [STAT_SAT_CONFLICTS] = "SAT conflicts",
+  [STAT_MOVES] = "Local search moves",
+};
+
+void setup_stats(unsigned int nworkers)
+{
+  char *space = alloc((nworkers + 1) * sizeof(StatBlock));
+  // Align to the cache line size. The slack is never freed.
+  space += (CACHE_LINE_SIZE - (uintptr_t)space % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+  stat_blocks = (StatBlock*)space;
+  stat_block_count = nworkers;
+}
+
+void reset_stats(void)
+// Not thread-safe: call it only when no tasks are running.
+{
+  memset(stat_blocks, 0, stat_block_count * sizeof(StatBlock));
+}
+
+uint64_t get_stat(Stat stat)
+// Not thread-safe: call it only when no tasks are running.
+{
+  uint64_t sum = 0;
+  unsigned int i;
+  for (i = 0; i < stat_block_count; i++)
+    sum += stat_blocks[i].counters[stat];
+  return sum;
+}
+
+void print_stats(void)
+{
+  unsigned int i;
+  for (i = 0; i < STAT_COUNT; i++)
+    printf("%s: %ju\n", stat_names[i], get_stat(i));
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,77 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NONOGRAM_STATS_H
+#define NONOGRAM_STATS_H
+
+#include <stdint.h>
+
+#include "task.h"
+
+#define CACHE_LINE_SIZE 64
+
+typedef enum
+{
+  STAT_LINE_SOLVES, // finger_line() and touch_line() calls
+  STAT_SHAKES,
+  STAT_NODES,       // backtrack() calls
+  STAT_SPLITS,      // nodes explored in parallel
+  STAT_REGIONS,     // independent parts of the search
+  STAT_TT_PROBES,   // transposition table lookups
+  STAT_TT_HITS,     // nodes pruned thanks to the transposition table
+  STAT_TT_STORES,   // refuted nodes recorded in the transposition table
+  STAT_NOGOODS,     // cells forced by conflict analysis
+  STAT_BACKJUMPS,   // decisions skipped by conflict analysis
+  STAT_RESTARTS,
+  STAT_SAT_DECISIONS,
+  STAT_SAT_CONFLICTS,
+  STAT_MOVES,       // blocks shifted by the local search
+  STAT_COUNT
+} Stat;
+
+typedef union
+// Every worker gets its own cache line(s), so that counting is cheap
+// and doesn't need any synchronization.
+{
+  uint64_t counters[STAT_COUNT];
+  char padding[(STAT_COUNT * sizeof(uint64_t) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE];
+} StatBlock;
+
+extern StatBlock *stat_blocks;
+
+void setup_stats(unsigned int);
+void reset_stats(void);
+uint64_t get_stat(Stat);
+void print_stats(void);
+
+static inline void count_stat(Stat stat)
+{
+  stat_blocks[get_worker_id()].counters[stat]++;
+}
+
+static inline void add_stat(Stat stat, uint64_t n)
+{
+  stat_blocks[get_worker_id()].counters[stat] += n;
+}
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,307 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* A minimal work-stealing scheduler.
+ *
+ * Every worker owns a Chase–Lev deque (“Correct and Efficient Work-Stealing
+ * for Weak Memory Models”, Lê et al., 2013). The owner pushes and takes tasks
+ * at the bottom; idle workers steal them from the top. The main thread is
+ * worker #0; the remaining workers are POSIX threads.
+ *
+ * With a single worker, tasks are run right away, so the serial code path
+ * does not touch any atomics at all.
+ */
+
+#include "autoconfig.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "memory.h"
+#include "task.h"
+
+#define DEQUE_SIZE 4096 // must be a power of 2
+#define IDLE_SPINS 64
+#define IDLE_SLEEP_NS 10000000
+
+typedef struct
+{
+  atomic_ptrdiff_t top, bottom;
+  Task *_Atomic tasks[DEQUE_SIZE];
+} Deque;
+
+typedef struct
+{
+  Deque deque;
+  pthread_t thread;
+  unsigned int id;
+  unsigned int seed;
+} Worker;
+
+static Worker *workers = NULL;
+static unsigned int worker_count = 1;
+__thread unsigned int current_worker_id = 0;
+
+static atomic_bool shutting_down;
+static atomic_uint sleepers;
+static pthread_mutex_t sleep_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cond = PTHREAD_COND_INITIALIZER;
+
+static bool push_task(Deque *deque, Task *task)
+{
+  ptrdiff_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  ptrdiff_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+  if (b - t >= DEQUE_SIZE)
+    return false;
+  atomic_store_explicit(&deque->tasks[b & (DEQUE_SIZE - 1)], task, memory_order_relaxed);
+  atomic_store_explicit(&deque->bottom, b + 1, memory_order_release);
+  return true;
+}
+
+static Task *take_task(Deque *deque)
+// Take a task from the bottom of the own deque.
+{
+  Task *task;
+  ptrdiff_t b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  ptrdiff_t t;
+
+  atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+  if (t > b)
+  {
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return NULL;
+  }
+  task = atomic_load_explicit(&deque->tasks[b & (DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (t == b)
+  {
+    // The last task: race against the thieves.
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+      task = NULL;
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+  }
+  return task;
+}
+
+static Task *steal_task(Deque *deque)
+// Steal a task from the top of somebody else's deque.
+{
+  Task *task;
+  ptrdiff_t t = atomic_load_explicit(&deque->top, memory_order_acquire);
+  ptrdiff_t b;
+
+  atomic_thread_fence(memory_order_seq_cst);
+  b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+  if (t >= b)
+    return NULL;
+  task = atomic_load_explicit(&deque->tasks[t & (DEQUE_SIZE - 1)], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+    return NULL;
+  return task;
+}
+
+static Task *find_task(Worker *self)
+{
+  unsigned int i, victim;
+  Task *task = take_task(&self->deque);
+  if (task != NULL)
+    return task;
+  // xorshift
+  self->seed ^= self->seed << 13;
+  self->seed ^= self->seed >> 17;
+  self->seed ^= self->seed << 5;
+  victim = self->seed % worker_count;
+  for (i = 0; i < worker_count; i++, victim = (victim + 1) % worker_count)
+  {
+    if (victim == self->id)
+      continue;
+    task = steal_task(&workers[victim].deque);
+    if (task != NULL)
+      return task;
+  }
+  return NULL;
+}
+
+static inline void run_task(Task *task)
+{
+  TaskGroup *group = task->group;
+  task->function(task->arg);
+  atomic_fetch_sub_explicit(&group->pending, 1, memory_order_release);
+}
+
+static void idle_wait(void)
+{
+  struct timespec deadline;
+
+  pthread_mutex_lock(&sleep_mutex);
+  atomic_fetch_add(&sleepers, 1);
+  // A task might have been pushed before we announced ourselves;
+  // the timeout makes sure we don't sleep through it for too long.
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_nsec += IDLE_SLEEP_NS;
+  if (deadline.tv_nsec >= 1000000000L)
+  {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  if (!atomic_load(&shutting_down))
+    pthread_cond_timedwait(&sleep_cond, &sleep_mutex, &deadline);
+  atomic_fetch_sub(&sleepers, 1);
+  pthread_mutex_unlock(&sleep_mutex);
+}
+
+static void *worker_main(void *arg)
+{
+  Worker *self = arg;
+  Task *task;
+  unsigned int idle = 0;
+
+  current_worker_id = self->id;
+  while (!atomic_load_explicit(&shutting_down, memory_order_relaxed))
+  {
+    task = find_task(self);
+    if (task != NULL)
+    {
+      run_task(task);
+      idle = 0;
+    }
+    else if (++idle < IDLE_SPINS)
+      sched_yield();
+    else
+    {
+      idle_wait();
+      idle = 0;
+    }
+  }
+  return NULL;
+}
+
+void setup_tasks(unsigned int nthreads)
+// Start the workers. The calling thread becomes worker #0.
+{
+  unsigned int i;
+  int rc;
+
+  assert(workers == NULL);
+  if (nthreads < 1)
+    nthreads = 1;
+  worker_count = nthreads;
+  workers = alloc(nthreads * sizeof(Worker));
+  atomic_init(&shutting_down, false);
+  atomic_init(&sleepers, 0);
+  for (i = 0; i < nthreads; i++)
+  {
+    atomic_init(&workers[i].deque.top, 0);
+    atomic_init(&workers[i].deque.bottom, 0);
+    workers[i].id = i;
+    workers[i].seed = 2463534242U + i;
+  }
+  current_worker_id = 0;
+  for (i = 1; i < nthreads; i++)
+  {
+    rc = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    if (rc != 0)
+    {
+      fprintf(stderr, "%s: cannot start a thread\n", PACKAGE_NAME);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+void shutdown_tasks(void)
+{
+  unsigned int i;
+
+  if (workers == NULL)
+    return;
+  atomic_store(&shutting_down, true);
+  pthread_mutex_lock(&sleep_mutex);
+  pthread_cond_broadcast(&sleep_cond);
+  pthread_mutex_unlock(&sleep_mutex);
+  for (i = 1; i < worker_count; i++)
+    pthread_join(workers[i].thread, NULL);
+  free(workers);
+  workers = NULL;
+  worker_count = 1;
+}
+
+unsigned int get_worker_count(void)
+{
+  return worker_count;
+}
+
+void init_task_group(TaskGroup *group)
+{
+  atomic_init(&group->pending, 0);
+}
+
+void spawn_task(TaskGroup *group, Task *task, void (*function)(void*), void *arg)
+// The task must stay around until sync_tasks() on the group returns.
+{
+  task->function = function;
+  task->arg = arg;
+  task->group = group;
+  if (worker_count == 1)
+  {
+    function(arg);
+    return;
+  }
+  atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+  if (!push_task(&workers[current_worker_id].deque, task))
+  {
+    run_task(task);
+    return;
+  }
+  if (atomic_load(&sleepers) > 0)
+  {
+    pthread_mutex_lock(&sleep_mutex);
+    pthread_cond_signal(&sleep_cond);
+    pthread_mutex_unlock(&sleep_mutex);
+  }
+}
+
+void sync_tasks(TaskGroup *group)
+// Wait until all the tasks spawned in the group are finished.
+// Meanwhile, help with whatever work is available.
+{
+  Task *task;
+
+  if (worker_count == 1)
+    return;
+  while (atomic_load_explicit(&group->pending, memory_order_acquire) > 0)
+  {
+    task = find_task(&workers[current_worker_id]);
+    if (task != NULL)
+      run_task(task);
+    else
+      sched_yield();
+  }
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,56 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NONOGRAM_TASK_H
+#define NONOGRAM_TASK_H
+
+#include <stdatomic.h>
+
+typedef struct
+{
+  atomic_uint pending; // spawned, but not finished yet
+} TaskGroup;
+
+typedef struct
+{
+  void (*function)(void*);
+  void *arg;
+  TaskGroup *group;
+} Task;
+
+extern __thread unsigned int current_worker_id;
+
+void setup_tasks(unsigned int);
+void shutdown_tasks(void);
+unsigned int get_worker_count(void);
+
+static inline unsigned int get_worker_id(void)
+{
+  return current_worker_id;
+}
+
+void init_task_group(TaskGroup*);
+void spawn_task(TaskGroup*, Task*, void (*)(void*), void*);
+void sync_tasks(TaskGroup*);
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
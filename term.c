@@ -91,6 +91,8 @@ static void tput(char *str, int parm, char **cbuffer, unsigned int *n)
 
 void setup_termstrings(bool have_term, bool use_utf8, bool use_color)
 {
+  int i;
+
   term_strings.init = "";
   term_strings.hash = use_utf8 ? "\xe2\x96\x88\xe2\x96\x88" : "##";
   term_strings.light[0] = "";
@@ -99,10 +101,13 @@ void setup_termstrings(bool have_term, bool use_utf8, bool use_color)
   term_strings.error = "";
   term_strings.v = use_utf8 ? "\xe2\x94\x82" : "|";
   term_strings.h = use_utf8 ? "\xe2\x94\x80\xe2\x94\x80" : "--";
+  term_strings.h1 = use_utf8 ? "\xe2\x94\x80" : "-";
   term_strings.tl = use_utf8 ? "\xe2\x94\x8c" : ".";
   term_strings.tr = use_utf8 ? "\xe2\x94\x90" : ".";
   term_strings.bl = use_utf8 ? "\xe2\x94\x94" : "`";
   term_strings.br = use_utf8 ? "\xe2\x94\x98" : "'";
+  for (i = 0; i < 8; i++)
+    term_strings.paint[i] = "";
 
 #ifdef HAVE_NCURSES
 #define BUFFER_SIZE 4096
@@ -139,6 +144,8 @@ void setup_termstrings(bool have_term, bool use_utf8, bool use_color)
   TEND(term_strings.init);
   TBEGIN(); TPUT("smacs", -1); TPUT_ACS('q', 2); TPUT("rmacs", -1);
   TEND(term_strings.h);
+  TBEGIN(); TPUT("smacs", -1); TPUT_ACS('q', 1); TPUT("rmacs", -1);
+  TEND(term_strings.h1);
   TBEGIN(); TPUT("smacs", -1); TPUT_ACS('x', 1); TPUT("rmacs", -1);
   TEND(term_strings.v);
   TBEGIN(); TPUT("smacs", -1); TPUT_ACS('l', 1); TPUT("rmacs", -1);
@@ -161,6 +168,11 @@ void setup_termstrings(bool have_term, bool use_utf8, bool use_color)
     TEND(term_strings.light[1]);
     TBEGIN(); TPUT("bold", -1); TPUT("setaf", 7); TPUT("setab", COLOR_RED);
     TEND(term_strings.error);
+    for (i = 0; i < 8; i++)
+    {
+      TBEGIN(); TPUT("setab", i);
+      TEND(term_strings.paint[i]);
+    }
   }
   else
   {
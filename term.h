@@ -28,7 +28,9 @@ typedef struct
 {
   char *light[2], *dark, *color, *error;
   char *h, *v, *tl, *bl, *tr, *br;
+  char *h1; // h, but a single char wide
   char *hash;
+  char *paint[8]; // backgrounds in the ANSI colors
   char *init;
 } TermStrings;
 
@@ -0,0 +1,154 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Send a puzzle to “nonogram --daemon” and print the reply.
+ *
+ * Usage: nonogram-client [-l SECONDS] [-n N] SOCKET < PUZZLE
+ *
+ * The exit status is the one reported by the daemon.
+ */
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../daemon.h"
+
+#define STATUS_PREFIX "Exit status: "
+
+static void fail(const char *message)
+{
+  fprintf(stderr, "nonogram-client: %s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+static void show_usage(void)
+{
+  fprintf(stderr, "Usage: nonogram-client [-l SECONDS] [-n N] SOCKET < PUZZLE\n");
+  exit(EXIT_FAILURE);
+}
+
+static int connect_to(const char *path)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+    fail("socket path too long");
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  return fd;
+}
+
+static bool write_all(int fd, const char *buffer, size_t size)
+{
+  ssize_t n;
+
+  while (size > 0)
+  {
+    n = write(fd, buffer, size);
+    if (n <= 0)
+      return false;
+    buffer += n;
+    size -= n;
+  }
+  return true;
+}
+
+static int print_reply(FILE *file)
+// Copy the reply to stdout, except for the exit status at its end.
+{
+  char line[4096];
+  int rc = EXIT_FAILURE;
+  bool whole = true;
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if (whole && strncmp(line, STATUS_PREFIX, strlen(STATUS_PREFIX)) == 0)
+    {
+      rc = atoi(line + strlen(STATUS_PREFIX));
+      continue;
+    }
+    whole = strchr(line, '\n') != NULL;
+    fputs(line, stdout);
+  }
+  return rc;
+}
+
+int main(int argc, char **argv)
+{
+  char buffer[4096];
+  const char *time_limit = NULL, *node_limit = NULL;
+  size_t n;
+  int fd, c;
+  FILE *reply;
+  bool sent = true;
+
+  while ((c = getopt(argc, argv, "l:n:")) >= 0)
+  {
+    switch (c)
+    {
+    case 'l':
+      time_limit = optarg;
+      break;
+    case 'n':
+      node_limit = optarg;
+      break;
+    default:
+      show_usage();
+    }
+  }
+  if (optind != argc - 1)
+    show_usage();
+
+  signal(SIGPIPE, SIG_IGN);
+  fd = connect_to(argv[optind]);
+  if (time_limit != NULL)
+    sent = sent && dprintf(fd, "time-limit %s\n", time_limit) > 0;
+  if (node_limit != NULL)
+    sent = sent && dprintf(fd, "node-limit %s\n", node_limit) > 0;
+  while (sent && (n = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+    sent = write_all(fd, buffer, n);
+  // The daemon may have turned us away without reading; its reply says so.
+  shutdown(fd, SHUT_WR);
+
+  reply = fdopen(fd, "r");
+  if (reply == NULL)
+    fail("cannot read the reply");
+  c = print_reply(reply);
+  fclose(reply);
+  return c;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,356 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/* Compile puzzles into a pack (see pack.h) for “nonogram --pack”.
+ *
+ * Usage: nonogram-pack PACK INPUT...
+ *
+ * Every INPUT is a puzzle file, or a directory whose *.nin files are taken
+ * in the order of their names. A puzzle is named after its file, without
+ * the directory and the .nin suffix.
+ */
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../color.h"
+#include "../nonogram.h"
+#include "../pack.h"
+
+#define SUFFIX ".nin"
+
+typedef struct
+{
+  char *name;
+  uint16_t *words;
+  size_t nwords, room;
+} Puzzle;
+
+static Puzzle *puzzles;
+static size_t npuzzles;
+
+static void fail(const char *message)
+{
+  fprintf(stderr, "nonogram-pack: %s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+static void show_usage(void)
+{
+  fprintf(stderr, "Usage: nonogram-pack PACK INPUT...\n");
+  exit(EXIT_FAILURE);
+}
+
+static void *xrealloc(void *ptr, size_t size)
+{
+  ptr = realloc(ptr, size);
+  if (ptr == NULL)
+    fail("out of memory");
+  return ptr;
+}
+
+static void put_word(Puzzle *puzzle, unsigned int word)
+{
+  if (puzzle->nwords == puzzle->room)
+  {
+    puzzle->room = puzzle->room * 2 + 64;
+    puzzle->words = xrealloc(puzzle->words, puzzle->room * sizeof(uint16_t));
+  }
+  puzzle->words[puzzle->nwords++] = word;
+}
+
+static char *next_line(FILE *file, char **line, size_t *size, unsigned int *lineno)
+// Return the next line that isn't blank, or NULL at the end of the file.
+{
+  char *p;
+
+  while (getline(line, size, file) >= 0)
+  {
+    ++*lineno;
+    for (p = *line; *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'; p++)
+      ;
+    if (*p != '\0')
+      return p;
+  }
+  return NULL;
+}
+
+static bool parse_clues(Puzzle *puzzle, char *line, unsigned int size, const char *names, unsigned int ncolors)
+// Append the blocks of a line. Return false if they don't fit.
+{
+  static unsigned int lengths[MAX_LARGE_SIZE], blockcolors[MAX_LARGE_SIZE];
+  unsigned int n = 0, i, length, color, used = 0;
+  char *token, *end, *name;
+
+  for (token = strtok(line, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n"))
+  {
+    length = strtoul(token, &end, 10);
+    if (end == token || n == size)
+      return false;
+    color = 1;
+    if (*end != '\0')
+    {
+      name = ncolors > 0 ? strchr(names, *end) : NULL;
+      if (name == NULL || end[1] != '\0')
+        return false;
+      color = name - names + 1;
+    }
+    if (length == 0)
+    {
+      // A single 0 stands for an empty line.
+      if (n > 0 || strtok(NULL, " \t\r\n") != NULL)
+        return false;
+      break;
+    }
+    used += length + (n > 0 && (ncolors == 0 || blockcolors[n - 1] == color));
+    if (length > size || used > size)
+      return false;
+    lengths[n] = length;
+    blockcolors[n] = color;
+    n++;
+  }
+  put_word(puzzle, n);
+  for (i = 0; i < n; i++)
+    put_word(puzzle, lengths[i]);
+  if (ncolors > 0)
+    for (i = 0; i < n; i++)
+      put_word(puzzle, blockcolors[i]);
+  return true;
+}
+
+static void compile_puzzle(const char *path, const char *name)
+{
+  Puzzle *puzzle;
+  FILE *file;
+  char *line = NULL, *p, *end;
+  char names[MAX_COLORS + 1];
+  size_t size = 0;
+  unsigned int lineno = 0, width, height, ncolors = 0, i, rgb;
+
+  file = fopen(path, "r");
+  if (file == NULL)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  puzzles = xrealloc(puzzles, (npuzzles + 1) * sizeof(Puzzle));
+  puzzle = puzzles + npuzzles++;
+  memset(puzzle, 0, sizeof(Puzzle));
+  puzzle->name = strdup(name);
+  if (puzzle->name == NULL)
+    fail("out of memory");
+
+  p = next_line(file, &line, &size, &lineno);
+  if (p == NULL || sscanf(p, "%u %u", &width, &height) != 2 || width < 1 || height < 1 || width > MAX_LARGE_SIZE || height > MAX_LARGE_SIZE)
+    goto invalid;
+  put_word(puzzle, width);
+  put_word(puzzle, height);
+  put_word(puzzle, 0); // the number of colors, for now
+  while ((p = next_line(file, &line, &size, &lineno)) != NULL && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+  {
+    if (ncolors == MAX_COLORS || memchr(names, *p, ncolors) != NULL)
+      goto invalid;
+    names[ncolors] = *p;
+    for (p++; *p == ' ' || *p == '\t'; p++)
+      ;
+    if (*p != '#')
+      goto invalid;
+    rgb = strtoul(p + 1, &end, 16);
+    if (end != p + 7 || strspn(end, " \t\r\n") != strlen(end))
+      goto invalid;
+    put_word(puzzle, names[ncolors]);
+    put_word(puzzle, rgb >> 16);
+    put_word(puzzle, rgb & 0xffff);
+    ncolors++;
+  }
+  names[ncolors] = '\0';
+  puzzle->words[2] = ncolors;
+  for (i = 0; i < height + width; i++)
+  {
+    if (i > 0)
+      p = next_line(file, &line, &size, &lineno);
+    if (p == NULL || !parse_clues(puzzle, p, i < height ? width : height, names, ncolors))
+      goto invalid;
+  }
+  free(line);
+  fclose(file);
+  return;
+
+invalid:
+  fprintf(stderr, "nonogram-pack: %s: invalid input at line %u\n", path, lineno);
+  exit(EXIT_FAILURE);
+}
+
+static bool has_suffix(const char *name)
+{
+  size_t n = strlen(name);
+  return n > strlen(SUFFIX) && strcmp(name + n - strlen(SUFFIX), SUFFIX) == 0;
+}
+
+static char *puzzle_name(const char *path)
+// Return the base name of the file, without the suffix.
+{
+  const char *base = strrchr(path, '/');
+  char *name = strdup(base != NULL ? base + 1 : path);
+  if (name == NULL)
+    fail("out of memory");
+  if (has_suffix(name))
+    name[strlen(name) - strlen(SUFFIX)] = '\0';
+  return name;
+}
+
+static int compare_strings(const void *a, const void *b)
+{
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static void compile_input(const char *path)
+{
+  DIR *dir;
+  struct dirent *entry;
+  char **files = NULL, *file, *name;
+  size_t nfiles = 0, i;
+
+  dir = opendir(path);
+  if (dir == NULL)
+  {
+    name = puzzle_name(path);
+    compile_puzzle(path, name);
+    free(name);
+    return;
+  }
+  while ((entry = readdir(dir)) != NULL)
+  if (has_suffix(entry->d_name))
+  {
+    files = xrealloc(files, (nfiles + 1) * sizeof(char*));
+    files[nfiles] = xrealloc(NULL, strlen(path) + strlen(entry->d_name) + 2);
+    sprintf(files[nfiles], "%s/%s", path, entry->d_name);
+    nfiles++;
+  }
+  closedir(dir);
+  qsort(files, nfiles, sizeof(char*), compare_strings);
+  for (i = 0; i < nfiles; i++)
+  {
+    file = files[i];
+    name = puzzle_name(file);
+    compile_puzzle(file, name);
+    free(name);
+    free(file);
+  }
+  free(files);
+}
+
+static int compare_puzzles(const void *a, const void *b)
+{
+  return strcmp(puzzles[*(const uint32_t*) a].name, puzzles[*(const uint32_t*) b].name);
+}
+
+static inline size_t align(size_t offset)
+{
+  return (offset + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+}
+
+static void write_pack(const char *path)
+{
+  PackHeader header;
+  PackEntry *entries;
+  uint32_t *by_name;
+  size_t i, offset;
+  FILE *file;
+  static const char padding[sizeof(uint32_t)];
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+  header.count = npuzzles;
+  header.entries = sizeof(header);
+  header.by_name = header.entries + npuzzles * sizeof(PackEntry);
+  entries = xrealloc(NULL, (npuzzles + 1) * sizeof(PackEntry));
+  by_name = xrealloc(NULL, (npuzzles + 1) * sizeof(uint32_t));
+  offset = header.by_name + npuzzles * sizeof(uint32_t);
+  for (i = 0; i < npuzzles; i++)
+  {
+    entries[i].name = offset;
+    offset += strlen(puzzles[i].name) + 1;
+    by_name[i] = i;
+  }
+  for (i = 0; i < npuzzles; i++)
+  {
+    offset = align(offset);
+    entries[i].puzzle = offset;
+    entries[i].nwords = puzzles[i].nwords;
+    offset += puzzles[i].nwords * sizeof(uint16_t);
+  }
+  if (offset > UINT32_MAX)
+    fail("too many puzzles for a pack");
+  header.size = offset;
+  qsort(by_name, npuzzles, sizeof(uint32_t), compare_puzzles);
+  for (i = 1; i < npuzzles; i++)
+    if (strcmp(puzzles[by_name[i - 1]].name, puzzles[by_name[i]].name) == 0)
+    {
+      fprintf(stderr, "nonogram-pack: more than one puzzle named %s\n", puzzles[by_name[i]].name);
+      exit(EXIT_FAILURE);
+    }
+
+  file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(entries, sizeof(PackEntry), npuzzles, file);
+  fwrite(by_name, sizeof(uint32_t), npuzzles, file);
+  for (i = 0; i < npuzzles; i++)
+    fwrite(puzzles[i].name, strlen(puzzles[i].name) + 1, 1, file);
+  for (i = 0; i < npuzzles; i++)
+  {
+    offset = ftell(file);
+    fwrite(padding, align(offset) - offset, 1, file);
+    fwrite(puzzles[i].words, sizeof(uint16_t), puzzles[i].nwords, file);
+  }
+  if (ferror(file) | fclose(file))
+  {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+  free(entries);
+  free(by_name);
+}
+
+int main(int argc, char **argv)
+{
+  int i;
+
+  if (argc < 3 || argv[1][0] == '-')
+    show_usage();
+  for (i = 2; i < argc; i++)
+    compile_input(argv[i]);
+  write_pack(argv[1]);
+  return EXIT_SUCCESS;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,155 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Decode a binary trace written by “nonogram --trace”.
+ *
+ * Records of all the workers are merged and printed in chronological order.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../trace.h"
+
+typedef struct
+{
+  uint32_t count, next;
+  TraceRecord *records;
+} WorkerTrace;
+
+static TraceHeader header;
+
+static const char *event_names[TRACE_EVENT_COUNT] = {
+  [TRACE_LINE_SOLVE] = "line-solve",
+  [TRACE_QUEUE_PUT] = "queue-put",
+  [TRACE_QUEUE_GET] = "queue-get",
+  [TRACE_SHAKE_BEGIN] = "shake-begin",
+  [TRACE_SHAKE_END] = "shake-end",
+  [TRACE_DECISION] = "decision",
+  [TRACE_REFUTATION] = "refutation",
+};
+
+static void fail(const char *message)
+{
+  fprintf(stderr, "nonogram-trace: %s\n", message);
+  exit(EXIT_FAILURE);
+}
+
+static void print_line(uint32_t line)
+{
+  if (line < header.ysize)
+    printf("row %u", line);
+  else
+    printf("column %u", line - header.ysize);
+}
+
+static void print_record(unsigned int worker, TraceRecord *record)
+{
+  const char *name = "?";
+
+  if (record->event < TRACE_EVENT_COUNT)
+    name = event_names[record->event];
+  printf("%12.3f  %2u  %-12s ", record->time / 1000.0, worker, name);
+  switch (record->event)
+  {
+  case TRACE_LINE_SOLVE:
+    print_line(record->a);
+    printf(", %d cells fixed", record->b);
+    break;
+  case TRACE_QUEUE_PUT:
+  case TRACE_QUEUE_GET:
+    print_line(record->a);
+    printf(", priority %d", record->b);
+    break;
+  case TRACE_SHAKE_BEGIN:
+  case TRACE_SHAKE_END:
+    printf("%u unknown cells", record->a);
+    break;
+  case TRACE_DECISION:
+  case TRACE_REFUTATION:
+    printf("cell (%u, %u), depth %d", record->a % header.xsize, record->a / header.xsize, record->b);
+    break;
+  default:
+    printf("%u %d", record->a, record->b);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  FILE *file;
+  WorkerTrace *workers;
+  unsigned int i, best;
+
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: nonogram-trace FILE\n");
+    return EXIT_FAILURE;
+  }
+  file = fopen(argv[1], "rb");
+  if (file == NULL)
+  {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+  if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0)
+    fail("not a trace file");
+  if (header.record_size != sizeof(TraceRecord) || header.xsize == 0)
+    fail("unsupported trace file");
+  workers = calloc(header.worker_count, sizeof(WorkerTrace));
+  if (workers == NULL)
+    fail("out of memory");
+  for (i = 0; i < header.worker_count; i++)
+  {
+    if (fread(&workers[i].count, sizeof(uint32_t), 1, file) != 1)
+      fail("truncated trace file");
+    workers[i].records = malloc((size_t)workers[i].count * sizeof(TraceRecord) + 1);
+    if (workers[i].records == NULL)
+      fail("out of memory");
+    if (fread(workers[i].records, sizeof(TraceRecord), workers[i].count, file) != workers[i].count)
+      fail("truncated trace file");
+  }
+  fclose(file);
+
+  printf("# %u worker(s), %ux%u grid\n", header.worker_count, header.xsize, header.ysize);
+  printf("# %10s  %2s  %-12s %s\n", "time [ms]", "w", "event", "details");
+  while (true)
+  {
+    best = header.worker_count;
+    for (i = 0; i < header.worker_count; i++)
+    {
+      if (workers[i].next >= workers[i].count)
+        continue;
+      if (best == header.worker_count ||
+        workers[i].records[workers[i].next].time < workers[best].records[workers[best].next].time)
+        best = i;
+    }
+    if (best == header.worker_count)
+      break;
+    print_record(best, &workers[best].records[workers[best].next++]);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
@@ -0,0 +1,87 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "autoconfig.h"
+
+#if ENABLE_TRACE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "memory.h"
+#include "nonogram.h"
+#include "timer.h"
+#include "trace.h"
+
+TraceBuffer *trace_buffers;
+double trace_start;
+static unsigned int trace_buffer_count;
+
+void setup_trace(unsigned int nworkers)
+{
+  unsigned int i;
+
+  trace_buffers = alloc(nworkers * sizeof(TraceBuffer));
+  for (i = 0; i < nworkers; i++)
+    trace_buffers[i].records = alloc(TRACE_BUFFER_SIZE * sizeof(TraceRecord));
+  trace_buffer_count = nworkers;
+  trace_start = get_time();
+}
+
+bool dump_trace(const char *filename)
+// Write the contents of the ring buffers to the file.
+// Not thread-safe: call it only when no tasks are running.
+{
+  TraceHeader header;
+  TraceBuffer *buffer;
+  uint32_t n, start;
+  unsigned int i;
+  bool ok;
+  FILE *file = fopen(filename, "wb");
+
+  if (file == NULL)
+    return false;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.record_size = sizeof(TraceRecord);
+  header.worker_count = trace_buffer_count;
+  header.xsize = xsize;
+  header.ysize = ysize;
+  fwrite(&header, sizeof(header), 1, file);
+  for (i = 0; i < trace_buffer_count; i++)
+  {
+    buffer = trace_buffers + i;
+    if (buffer->count <= TRACE_BUFFER_SIZE)
+      n = buffer->count, start = 0;
+    else
+      n = TRACE_BUFFER_SIZE, start = buffer->count & (TRACE_BUFFER_SIZE - 1);
+    fwrite(&n, sizeof(n), 1, file);
+    // The ring buffer may have wrapped around.
+    fwrite(buffer->records + start, sizeof(TraceRecord), n - start, file);
+    fwrite(buffer->records, sizeof(TraceRecord), start, file);
+  }
+  ok = !ferror(file);
+  return fclose(file) == 0 && ok;
+}
+
+#endif /* ENABLE_TRACE */
+
+/* vim:set ts=2 sts=2 sw=2 et: */
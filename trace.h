@@ -0,0 +1,106 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NONOGRAM_TRACE_H
+#define NONOGRAM_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Trace file layout (all integers in the host byte order):
+//   TraceHeader
+//   then, for each worker:
+//     uint32_t number of records
+//     TraceRecord records[], oldest first
+
+#define TRACE_MAGIC "NGTRACE1"
+
+typedef enum
+{
+  TRACE_LINE_SOLVE,  // a = line, b = number of cells fixed
+  TRACE_QUEUE_PUT,   // a = line, b = priority
+  TRACE_QUEUE_GET,   // a = line, b = priority
+  TRACE_SHAKE_BEGIN, // a = number of unknown cells
+  TRACE_SHAKE_END,   // a = number of unknown cells
+  TRACE_DECISION,    // a = cell, b = depth
+  TRACE_REFUTATION,  // a = cell, b = depth
+  TRACE_EVENT_COUNT
+} TraceEvent;
+
+typedef struct
+{
+  char magic[8];
+  uint32_t record_size;
+  uint32_t worker_count;
+  uint32_t xsize, ysize;
+} TraceHeader;
+
+typedef struct
+{
+  uint32_t time; // microseconds since the start
+  uint8_t event;
+  uint8_t reserved[3];
+  uint32_t a;
+  int32_t b;
+} TraceRecord;
+
+#if ENABLE_TRACE
+
+#include "task.h"
+#include "timer.h"
+
+#define TRACE_BUFFER_SIZE (1 << 16) // records per worker; must be a power of 2
+
+typedef struct
+{
+  uint64_t count;
+  TraceRecord *records;
+} TraceBuffer;
+
+extern TraceBuffer *trace_buffers;
+extern double trace_start;
+
+void setup_trace(unsigned int);
+bool dump_trace(const char*);
+
+static inline void trace_event(TraceEvent event, uint32_t a, int32_t b)
+{
+  TraceBuffer *buffer = trace_buffers + get_worker_id();
+  TraceRecord *record = buffer->records + (buffer->count++ & (TRACE_BUFFER_SIZE - 1));
+  record->time = (uint32_t)((get_time() - trace_start) * 1e6);
+  record->event = event;
+  record->a = a;
+  record->b = b;
+}
+
+#define TRACE(event, a, b) trace_event(event, a, b)
+
+#else
+
+// The arguments must not have side effects;
+// they are only mentioned to avoid unused-variable warnings.
+#define TRACE(event, a, b) do { (void)(a); (void)(b); } while (false)
+
+#endif /* ENABLE_TRACE */
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */
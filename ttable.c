@@ -0,0 +1,138 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Transposition table.
+ *
+ * Pictures are identified by their Zobrist hashes (Zobrist, “A New Hashing
+ * Method with Application for Game Playing”, 1970), which are cheap to update
+ * one cell at a time. The table remembers hashes of pictures that have been
+ * proven to have no solution, so that the search doesn't explore them again.
+ *
+ * The table is shared between the workers, but there is no locking:
+ * an entry is a single 64-bit word, so the worst that can happen is that
+ * a concurrently stored hash gets lost.
+ */
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "memory.h"
+#include "ttable.h"
+
+#define BUCKET_SIZE 4 // must be a power of 2
+
+static _Atomic uint64_t *entries = NULL;
+static unsigned int entry_count = 0;
+
+void setup_ttable(unsigned int size)
+// Allocate a table of (at most) size entries; size must be a power of 2.
+{
+  unsigned int i;
+
+  assert(entries == NULL);
+  assert((size & (size - 1)) == 0 && size >= BUCKET_SIZE);
+  entries = alloc(size * sizeof(*entries));
+  for (i = 0; i < size; i++)
+    atomic_init(entries + i, 0);
+  entry_count = size;
+}
+
+void clear_ttable(void)
+// Forget everything, e.g. before solving another puzzle.
+{
+  unsigned int i;
+
+  for (i = 0; i < entry_count; i++)
+    atomic_store_explicit(entries + i, 0, memory_order_relaxed);
+}
+
+static inline uint64_t normalize_hash(uint64_t hash)
+// 0 marks an empty entry.
+{
+  return hash != 0 ? hash : 1;
+}
+
+static inline _Atomic uint64_t *get_bucket(uint64_t hash)
+{
+  return entries + (hash & (entry_count - 1) & ~(uint64_t)(BUCKET_SIZE - 1));
+}
+
+bool probe_ttable(uint64_t hash)
+{
+  unsigned int i;
+  _Atomic uint64_t *bucket;
+
+  if (entries == NULL)
+    return false;
+  hash = normalize_hash(hash);
+  bucket = get_bucket(hash);
+  for (i = 0; i < BUCKET_SIZE; i++)
+    if (atomic_load_explicit(bucket + i, memory_order_relaxed) == hash)
+      return true;
+  return false;
+}
+
+void store_ttable(uint64_t hash)
+{
+  unsigned int i;
+  uint64_t entry;
+  _Atomic uint64_t *bucket;
+
+  if (entries == NULL)
+    return;
+  hash = normalize_hash(hash);
+  bucket = get_bucket(hash);
+  for (i = 0; i < BUCKET_SIZE; i++)
+  {
+    entry = atomic_load_explicit(bucket + i, memory_order_relaxed);
+    if (entry == hash)
+      return;
+    if (entry == 0)
+      break;
+  }
+  if (i == BUCKET_SIZE)
+  {
+    // The bucket is full: evict an entry, chosen by the upper bits of
+    // the hash (the lower ones have been used to select the bucket).
+    i = (hash >> 32) & (BUCKET_SIZE - 1);
+  }
+  atomic_store_explicit(bucket + i, hash, memory_order_relaxed);
+}
+
+unsigned int get_ttable_size(void)
+{
+  return entry_count;
+}
+
+unsigned int get_ttable_usage(void)
+// Not thread-safe: call it only when no tasks are running.
+{
+  unsigned int i, n = 0;
+  for (i = 0; i < entry_count; i++)
+    if (atomic_load_explicit(entries + i, memory_order_relaxed) != 0)
+      n++;
+  return n;
+}
+
+/* vim:set ts=2 sts=2 sw=2 et: */
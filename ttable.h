@@ -0,0 +1,50 @@
+/* Copyright © 2003-2014 Jakub Wilk <jwilk@jwilk.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NONOGRAM_TTABLE_H
+#define NONOGRAM_TTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nonogram.h"
+#include "random.h"
+
+static inline uint64_t zobrist_key(unsigned int n, bit value)
+// Key of the n-th cell being set to the value.
+// A picture's hash is XOR of the keys of all its known cells.
+// The keys are mixed from the cell and the value on the fly, rather than
+// kept in a table of 16 bytes per cell.
+{
+  uint64_t state = 2 * (uint64_t) n + (value == X);
+  return splitmix64(&state);
+}
+
+void setup_ttable(unsigned int);
+void clear_ttable(void);
+bool probe_ttable(uint64_t);
+void store_ttable(uint64_t);
+unsigned int get_ttable_size(void);
+unsigned int get_ttable_usage(void);
+
+#endif
+
+/* vim:set ts=2 sts=2 sw=2 et: */